@@ -176,6 +176,19 @@ ece391_vidmap (uint8_t** screen_start)
     return 0;
 }
 
+/* no io ring under Linux - callers fall back to plain reads */
+struct ece391_io_ring*
+ece391_ioring_setup (void)
+{
+    return ECE391_IORING_FAILED;
+}
+
+int32_t 
+ece391_ioring_enter (int32_t to_submit)
+{
+    return -1;
+}
+
 int32_t 
 ece391_read (int32_t fd, void* buf, int32_t nbytes)
 {
@@ -20,5 +20,53 @@ extern int32_t ece391_close (int32_t fd);
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 
+/*
+ * A page of submission and completion rings shared with the kernel, so
+ * several read/write/open/close calls cost one system call.  Fill in
+ * sqes[sq_tail % ECE391_IORING_SQ_ENTRIES] and bump sq_tail for each
+ * call, then hand them all over with ece391_ioring_enter; each one gets a
+ * completion with its user_data and what the call returned.  Reap them
+ * from cq_head up to cq_tail and bump cq_head.  The kernel runs them in
+ * order, and stops early if the completion ring is full.
+ * ece391_ioring_setup returns the page (the same one every time), or
+ * ECE391_IORING_FAILED.
+ */
+#define ECE391_IORING_FAILED	((void*)-1)
+
+#define ECE391_IORING_SQ_ENTRIES	64
+#define ECE391_IORING_CQ_ENTRIES	128
+
+#define ECE391_IORING_OP_NOP	0
+#define ECE391_IORING_OP_READ	1
+#define ECE391_IORING_OP_WRITE	2
+#define ECE391_IORING_OP_OPEN	3	/* addr is the file name */
+#define ECE391_IORING_OP_CLOSE	4
+
+struct ece391_io_sqe {
+	uint32_t user_data;
+	uint16_t op;
+	int16_t fd;
+	uint32_t addr;
+	int32_t len;
+};
+
+struct ece391_io_cqe {
+	uint32_t user_data;
+	int32_t res;
+};
+
+struct ece391_io_ring {
+	volatile uint32_t sq_head;	/* written by the kernel */
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;	/* written by the kernel */
+	uint32_t reserved[12];
+	struct ece391_io_sqe sqes[ECE391_IORING_SQ_ENTRIES];
+	struct ece391_io_cqe cqes[ECE391_IORING_CQ_ENTRIES];
+};
+
+extern struct ece391_io_ring* ece391_ioring_setup (void);
+extern int32_t ece391_ioring_enter (int32_t to_submit);
+
 #endif /* ECE391SYSCALL_H */
 
@@ -11,5 +11,10 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_IORING_SETUP 17
+#define SYS_IORING_ENTER 18
+
+/* time page word that is nonzero when the kernel takes sysenter (the stubs fall back to int $0x80) */
+#define SYSENTER_FLAG_ADDR 0x0840101C
 
 #endif /* ECE391SYSNUM_H */
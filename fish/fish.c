@@ -8,6 +8,7 @@
 uint8_t *vmem_base_addr;
 uint8_t *mp1_set_video_mode (void);
 void add_frames(uint8_t *, uint8_t *, int32_t);
+static void read_chars(int32_t fd[2], uint8_t c[2], int32_t eof[2]);
 void ece391_memset(void* memory, char c, int n);
 int32_t ece391_memcpy(void* dest, const void* src, int32_t n);
 
@@ -20,6 +21,9 @@ extern void mp1_rtc_tasklet(unsigned long trash);
 
 static struct mp1_blink_struct blink_array[80*25];
 
+/* io ring for the frame file reads, NULL if the kernel has none */
+static struct ece391_io_ring *ring;
+
 int main(void)
 {
     int rtc_fd, ret_val, i, garbage;
@@ -78,50 +82,38 @@ int main(void)
 void
 add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
 {
-    int32_t row, col, offset = 40, eof0 = 0, eof1 = 0, num_bytes;
-    int32_t fd0, fd1;
+    int32_t row, col, offset = 40;
+    int32_t fd[2], eof[2] = {0, 0};
     struct mp1_blink_struct blink_struct;
-    uint8_t c0 = '0', c1 = '0';
+    uint8_t c[2] = {'0', '0'};
 
     blink_struct.on_length = 15;
     blink_struct.off_length = 15;
 
     row = 0;
 
-    if( (fd0 = ece391_open(f0)) < 0 ) {
+    if( (fd[0] = ece391_open(f0)) < 0 ) {
         ece391_halt(-1);
     }
-    if( (fd1 = ece391_open(f1)) < 0 ) {
+    if( (fd[1] = ece391_open(f1)) < 0 ) {
         ece391_halt(-1);
     }
 
-    while(eof0 == 0 || eof1 == 0) {
+    ring = ece391_ioring_setup();
+
+    while(eof[0] == 0 || eof[1] == 0) {
         col = 0;
         while(1) {
 
-            if(c0 != '\n') {
-                num_bytes = ece391_read(fd0, &c0, 1);
-                if(num_bytes == 0) {
-                    c0 = '\n';
-                    eof0 = 1;
-                }
-            }
-
-            if(c1 != '\n') {
-                num_bytes = ece391_read(fd1, &c1, 1);
-                if(num_bytes == 0) {
-                    c1 = '\n';
-                    eof1 = 1;
-                }
-            }
+            read_chars(fd, c, eof);
 
-            if(c0 == '\n' && c1 == '\n') {
+            if(c[0] == '\n' && c[1] == '\n') {
                 break;
 
             } else {
-                if((c0 != ' ' && c0 != '\n') || (c1 != ' ' && c1 != '\n')) {
-                    blink_struct.on_char = ( (c0 == '\n') ? ' ' : c0);
-                    blink_struct.off_char = ( (c1 == '\n') ? ' ' : c1);
+                if((c[0] != ' ' && c[0] != '\n') || (c[1] != ' ' && c[1] != '\n')) {
+                    blink_struct.on_char = ( (c[0] == '\n') ? ' ' : c[0]);
+                    blink_struct.off_char = ( (c[1] == '\n') ? ' ' : c[1]);
                     blink_struct.location = row*80 + col + offset;
                     mp1_ioctl((unsigned long)&blink_struct, RTC_ADD);
                 }
@@ -129,24 +121,73 @@ add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
             col++;
         }
 
-        if(eof0) {
-            c0 = '\n';
-            ece391_close(fd0);
+        if(eof[0]) {
+            c[0] = '\n';
+            ece391_close(fd[0]);
         } else {
-            c0 = '0';
+            c[0] = '0';
         }
 
-        if(eof1) {
-            c1 = '\n';
-            ece391_close(fd1);
+        if(eof[1]) {
+            c[1] = '\n';
+            ece391_close(fd[1]);
         } else {
-            c1 = '0';
+            c[1] = '0';
         }
 
         row++;
     }
 }
 
+/*
+ * read_chars - reads the next character of each frame file whose line
+ * isn't done yet (c[i] isn't a newline).  A file that has ended gets a
+ * newline and its eof flag.  With an io ring both reads take one system
+ * call instead of two.
+ */
+static void
+read_chars(int32_t fd[2], uint8_t c[2], int32_t eof[2])
+{
+    struct ece391_io_sqe *sqe;
+    struct ece391_io_cqe *cqe;
+    int32_t n[2] = {1, 1}, i, queued = 0;
+
+    for(i = 0; i < 2; i++) {
+        if(c[i] == '\n') {
+            continue;
+        }
+        if(ring == ECE391_IORING_FAILED) {
+            n[i] = ece391_read(fd[i], &c[i], 1);
+            continue;
+        }
+        n[i] = -1;      /* until its completion says otherwise */
+        sqe = &ring->sqes[ring->sq_tail % ECE391_IORING_SQ_ENTRIES];
+        sqe->user_data = i;
+        sqe->op = ECE391_IORING_OP_READ;
+        sqe->fd = fd[i];
+        sqe->addr = (uint32_t)&c[i];
+        sqe->len = 1;
+        ring->sq_tail++;
+        queued++;
+    }
+
+    if(queued != 0) {
+        ece391_ioring_enter(queued);
+        while(ring->cq_head != ring->cq_tail) {
+            cqe = &ring->cqes[ring->cq_head % ECE391_IORING_CQ_ENTRIES];
+            n[cqe->user_data] = cqe->res;
+            ring->cq_head++;
+        }
+    }
+
+    for(i = 0; i < 2; i++) {
+        if(n[i] <= 0) {
+            c[i] = '\n';
+            eof[i] = 1;
+        }
+    }
+}
+
 uint8_t*
 mp1_set_video_mode (void)
 {
@@ -0,0 +1,64 @@
+/* clock.c - Monotonic and wall-clock time: the TSC calibrated against the PIT,
+ * the CMOS clock read once at boot
+ */
+
+#include "clock.h"
+#include "lib.h"
+#include "rtc.h"
+#include "schedule.h"
+
+// backs time_page - inside the kernel's 4MB page, mapped read-only for user programs by map_time_page
+static uint8_t time_page_frame[FOUR_KB] __attribute__((aligned(FOUR_KB)));
+
+/* clock_init()
+ * Measures the TSC frequency against the PIT, reads the CMOS clock and maps the time page
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: busy-waits CLOCK_CALIBRATE_MS plus up to a second for the CMOS clock,
+ *               has to run with interrupts off and after init_paging
+ */
+void clock_init(void){
+    uint64_t start, cycles, scaled;
+    uint32_t wall;
+
+    time_page = (time_page_t*)time_page_frame;
+    memset(time_page_frame, 0, FOUR_KB);
+
+    start = rdtsc();
+    pit_wait(PIT_FREQ / 1000 * CLOCK_CALIBRATE_MS);
+    cycles = rdtsc() - start;
+
+    // mult = (calibration ns << shift) / calibration cycles, which stays well below 2^32 for any TSC above 1MHz
+    scaled = ((uint64_t)CLOCK_CALIBRATE_MS * 1000000) << CLOCK_SHIFT;
+    div64_32(&scaled, (uint32_t)cycles);
+    time_page->mult = (uint32_t)scaled;
+    time_page->shift = CLOCK_SHIFT;
+    time_page->tsc_khz = (uint32_t)cycles / CLOCK_CALIBRATE_MS;
+    time_page->base_tsc = start;
+
+    // the CMOS clock only has whole seconds, so the wall clock is good to about a second
+    wall = rtc_read_wallclock();
+    time_page->wall_offset_ns = (uint64_t)wall * NSEC_PER_SEC - clock_ns(CLOCK_MONOTONIC);
+
+    map_time_page((uint32_t)time_page_frame);
+}
+
+/* clock_ns(int32_t clock_id)
+ * Reads a clock - the same computation user programs do on the time page
+ * Inputs: clock_id - CLOCK_MONOTONIC or CLOCK_REALTIME
+ * Outputs: the time in nanoseconds
+ * Side Effects: none
+ */
+uint64_t clock_ns(int32_t clock_id){
+    uint64_t delta = rdtsc() - time_page->base_tsc;
+    uint64_t ns;
+
+    // two 32x32 bit products can't overflow, a single 64x32 bit one would after a few hours of uptime
+    ns = ((uint64_t)(uint32_t)delta * time_page->mult) >> time_page->shift;
+    ns += ((uint64_t)(uint32_t)(delta >> 32) * time_page->mult) << (32 - time_page->shift);
+
+    if(clock_id == CLOCK_REALTIME){
+        ns += time_page->wall_offset_ns;
+    }
+    return ns;
+}
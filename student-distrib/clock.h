@@ -0,0 +1,48 @@
+/* clock.h - Monotonic and wall-clock time: the TSC calibrated against the PIT,
+ * the CMOS clock read once at boot
+ */
+
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+#include "types.h"
+
+#define CLOCK_REALTIME      0           // seconds since 1970, from the CMOS clock
+#define CLOCK_MONOTONIC     1           // time since boot, never goes back
+
+#define NSEC_PER_SEC        1000000000
+#define CLOCK_CALIBRATE_MS  50          // longest one-shot pit_wait can do is ~55ms
+#define CLOCK_SHIFT         22          // fraction bits of time_page_t.mult
+
+#define TIME_PAGE_ADDR      0x08401000  // 132MB + 4kB, right after the vidmap page
+#define TIME_PAGE_ENTRY     1           // its entry in vidmap_page_table
+
+#ifndef ASM
+
+typedef struct timespec {
+    uint32_t tv_sec;
+    uint32_t tv_nsec;
+} timespec_t;
+
+/* Mapped read-only into every process at TIME_PAGE_ADDR so programs can read the clock without a
+ * system call. Written once by clock_init (and sysenter by syscall_init), before any program runs. For a TSC value t:
+ *   CLOCK_MONOTONIC ns = ((t - base_tsc) * mult) >> shift, the 64 bit delta multiplied in 32 bit halves
+ *   CLOCK_REALTIME ns  = CLOCK_MONOTONIC ns + wall_offset_ns
+ */
+typedef struct time_page {
+    uint64_t base_tsc;                  // TSC value at monotonic time 0
+    uint64_t wall_offset_ns;            // CLOCK_REALTIME - CLOCK_MONOTONIC
+    uint32_t mult;                      // ns per TSC cycle, fixed point
+    uint32_t shift;                     // fraction bits in mult
+    uint32_t tsc_khz;                   // TSC frequency, for programs that measure in cycles
+    uint32_t sysenter;                  // 1 if the kernel takes system calls through sysenter - the user stubs check it
+} time_page_t;
+
+time_page_t* time_page;
+
+void clock_init(void);
+uint64_t clock_ns(int32_t clock_id);
+
+#endif /* ASM */
+
+#endif /* _CLOCK_H */
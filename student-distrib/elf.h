@@ -0,0 +1,46 @@
+/* elf.h - The parts of the ELF format the program loader needs
+ */
+
+#ifndef _ELF_H
+#define _ELF_H
+
+#include "types.h"
+
+#define ELF_MAGIC           0x464C457F  // 0x7F 'E' 'L' 'F', read as a little endian word
+#define ELF_MAX_PHDRS       16          // our programs have 2 or 3 program headers
+
+#define PT_LOAD             1           // segment to be loaded into memory
+#define PF_W                0x2         // segment is writable
+
+// ELF file header (32 bit)
+typedef struct elf_header {
+    uint32_t magic;
+    uint8_t ident[12];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;                     // address of the first instruction
+    uint32_t phoff;                     // file offset of the program headers
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;                 // size of one program header
+    uint16_t phnum;                     // number of program headers
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} __attribute__((packed)) elf_header_t;
+
+// ELF program header (32 bit) - describes one segment
+typedef struct elf_phdr {
+    uint32_t type;
+    uint32_t offset;                    // where the segment's bytes start in the file
+    uint32_t vaddr;                     // where they go in memory
+    uint32_t paddr;
+    uint32_t filesz;                    // bytes in the file, the rest up to memsz is zeroed
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+} __attribute__((packed)) elf_phdr_t;
+
+#endif /* _ELF_H */
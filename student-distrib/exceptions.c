@@ -68,6 +68,108 @@ void handle_exception(unsigned vec){
     while(1);
 }
 
+/* shared_block(pcb_t* pcb, uint32_t page)
+ * Read-only pages that hold nothing but one segment's bytes, 4kB aligned in the file, are a data block of the
+ * filesystem image as they are - the program can use the block itself instead of a copy
+ * Inputs: pcb - the program
+ *         page - user page, not writable
+ * Outputs: address of the block, 0 if the page needs a frame of its own
+ */
+static uint32_t shared_block(pcb_t* pcb, uint32_t page){
+    elf_phdr_t* seg;
+    int i;
+
+    for(i = 0; i < pcb->exe_nsegs; i++){
+        seg = &pcb->exe_segs[i];
+        if(page >= seg->vaddr && page + FOUR_KB <= seg->vaddr + seg->filesz &&
+           ((seg->offset + page - seg->vaddr) & (FOUR_KB - 1)) == 0){
+            return file_block_addr(pcb->exe_inode, seg->offset + page - seg->vaddr);
+        }
+    }
+    return 0;
+}
+
+/* int32_t user_page_fault(uint32_t addr, uint32_t error)
+ * Backs a page of the running program the first time it is touched: read-only pages straight from the
+ * filesystem image where they can be, otherwise with a frame of its own that the part of the program file
+ * that belongs there is read into - the rest of the page (bss, stack) stays zero
+ * Inputs: addr - faulting address (CR2)
+ *         error - error code the CPU pushed
+ * Outputs: 0 if the page is there now and the instruction can run again, -1 if it is a real fault
+ * Side Effects: works for the kernel touching a user buffer in a system call too
+ */
+static int32_t user_page_fault(uint32_t addr, uint32_t error){
+    pcb_t* pcb;
+    pte_t* entry;
+    elf_phdr_t* seg;
+    uint32_t page, frame, start, end;
+    int i;
+
+    // a protection violation on a page that is there isn't ours to fix
+    if((error & PF_ERR_PRESENT) || addr < USER_BASE || addr >= USER_STACK_TOP || curr_pid == IDLE_PID){
+        return -1;
+    }
+    pcb = get_pcb_from_pid(curr_pid);
+    if(pcb == NULL || pcb->user_page_table == NULL){
+        return -1;
+    }
+    entry = &pcb->user_page_table[(addr >> ADDRESS_SHIFT_KB) & (NUM_ENTRIES - 1)];
+    if(!(entry->offset11_9 & PTE_LAZY)){
+        return -1;
+    }
+
+    page = addr & ~(FOUR_KB - 1);
+    if(!entry->R){
+        frame = shared_block(pcb, page);
+        if(frame != 0){
+            user_map_shared(pcb->user_page_table, page, frame);
+            return 0;
+        }
+    }
+    if(user_map_page(pcb->user_page_table, page, entry->R) == -1){
+        return -1;
+    }
+
+    // filled in through the frame's identity mapping, so read-only pages work the same - a page can hold the end of
+    // one segment and the start of the next
+    frame = entry->offset31_12 << ADDRESS_SHIFT_KB;
+    for(i = 0; i < pcb->exe_nsegs; i++){
+        seg = &pcb->exe_segs[i];
+        start = (seg->vaddr > page) ? seg->vaddr : page;
+        end = (seg->vaddr + seg->filesz < page + FOUR_KB) ? seg->vaddr + seg->filesz : page + FOUR_KB;
+        if(start < end){
+            read_data(pcb->exe_inode, seg->offset + (start - seg->vaddr), (uint8_t*)(frame + start - page), end - start);
+        }
+    }
+    return 0;
+}
+
+/* page_fault_excep(uint32_t error)
+ * Page fault handler: loads pages of the program that aren't there yet, anything else is an exception
+ * Inputs: error - error code the CPU pushed
+ * Outputs: none
+ * Side Effects: a program that touches memory it doesn't have is halted
+ */
+void page_fault_excep(uint32_t error){
+    uint32_t addr;
+
+    asm volatile ("movl %%cr2, %0" : "=r"(addr));
+    if(user_page_fault(addr, error) == 0){
+        return;
+    }
+
+    // the error code says whether the program or the kernel faulted, no need to guess from ESP - a kernel fault on a
+    // user page (a system call writing to a read-only buffer that slipped past its checks) is the program's fault too
+    if((error & PF_ERR_USER) || (addr >= USER_BASE && addr < USER_STACK_TOP && curr_pid != IDLE_PID)){
+        clear();
+        printf("Interrupt vector 0x%x -- %s\n", 14, exception_msgs[14]);
+        printf("CR2: %x\n", addr);
+        exception_flag = 1;     // make sys_halt aware that this was an exception
+        sys_halt(255);
+    }
+    handle_exception(14);
+}
+
 /*Definition of exception handlers - just routed through handle_exception function*/
 void divide_err_excep() { handle_exception(0); }
 void debug_excep() { handle_exception(1); }
@@ -83,7 +185,6 @@ void invalid_tss_excep() { handle_exception(10); }
 void seg_not_present_excep() { handle_exception(11); }
 void stack_seg_fault_excep() { handle_exception(12); }
 void general_protection_excep() { handle_exception(13); }
-void page_fault_excep() { handle_exception(14); }
 void fpu_float_err_excep() { handle_exception(16); }
 void align_check_excep() { handle_exception(17); }
 void machine_check_excep() { handle_exception(18); }
@@ -9,6 +9,11 @@ void handle_exception(unsigned vec);
  /* Temporary function before actual system calls implemented that prints system call message */
 void handle_system_call();
 
+/* page fault error code bits */
+#define PF_ERR_PRESENT  0x1     // the page was present, so it was a protection violation
+#define PF_ERR_WRITE    0x2
+#define PF_ERR_USER     0x4     // the fault happened in user mode
+
 /* array of exception message strings */
 const char* exception_msgs[20];
 
@@ -27,7 +32,7 @@ void invalid_tss_excep();
 void seg_not_present_excep();
 void stack_seg_fault_excep();
 void general_protection_excep();
-void page_fault_excep();
+void page_fault_excep(uint32_t error);
 void fpu_float_err_excep();
 void align_check_excep();
 void machine_check_excep();
@@ -100,7 +100,9 @@ uint32_t read_dentry_by_index (uint32_t index, dentry_t* dentry){
  *          : buf - read info placed in here
  *          : length - tell us how many bytes to read
  * Outputs  : returns the number of bytes read, or 0 if end of file reached, or -1 on failure
- * Side effects : bytes read are placed in the buffer
+ * Side effects : bytes read are placed in the buffer - the read stops at the end of the file. The inode's
+ *                data_block_num array gives the block for any offset directly, so where the read starts doesn't
+ *                matter, and each block is copied in one go
  */
 uint32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
     /* check if filesystem not initialized or if inode number is invalid */
@@ -109,130 +111,63 @@ uint32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t leng
     }
 
     /* retrieve inode */
-    uint32_t* i = (uint32_t*)((uint32_t)the_boot_block + BLOCK_SIZE * (inode + 1));
+    inode_t* i = (inode_t*)((uint32_t)the_boot_block + BLOCK_SIZE * (inode + 1));
 
-    /* if offset is greater than length of inode(first element of i is its length), then reached end of file */
-    if (offset > *i) {
+    /* if offset is at or past the length of the inode, then reached end of file */
+    if (offset >= i->length) {
         return 0;
     }
+    if (length > i->length - offset) {
+        length = i->length - offset;
+    }
 
-    /* first, get us ptr to start of data blocks (N blocks after boot block) */
-    uint32_t* start_datablocks = (uint32_t*)((uint32_t)the_boot_block + BLOCK_SIZE * (the_boot_block->inode_count + 1));
-    /* next, get us index of 0th data block # (index) */
-    int num_data_block = 0;     // # of data block we are on in the inode
-    //uint32_t* cur_datablock_index_addr = (uint32_t*)((inode_t*) i)->data_block_num[num_data_block]; // addr
-    uint32_t* cur_datablock_index_addr = i + 1;     // add 1 (uint32_t, so 1 = 4B) to get us address at 0th data block number (in inode)
-    // apply offset
-    //cur_datablock_index_addr += (offset/BLOCK_SIZE) * 4;       // each data block index is 4B (diagram), division is floored in C -> NOT TIMES FOUR IMMA IDIOT
-    cur_datablock_index_addr += (offset/BLOCK_SIZE);       // each data block index is 4B (diagram), division is floored in C
-    uint32_t cur_datablock_index = *cur_datablock_index_addr;
-    num_data_block = (offset/BLOCK_SIZE);
-    // get the actual data block's addr
-    uint32_t* cur_datablock = start_datablocks + cur_datablock_index * BLOCK_SIZE/sizeof(uint32_t);
-
-    /* setup for looping */
-    uint32_t position_in_file = (offset % BLOCK_SIZE)/4;
-    //uint32_t offset_in_address = offset % 4;    // each address contains 4 bytes, we need offset in address of starting point
-
-    /* loop through data and read to buffer */
-    
-    uint32_t bytes_read;
-    int offset_in_address;
-    for (bytes_read = 0; bytes_read < length; bytes_read++) {
-        offset_in_address = (offset + bytes_read) % 4;     // addresses contained 4 bytes each
-        if (offset_in_address == 0) {
-            buf[bytes_read] = ((*(cur_datablock + position_in_file))) & 0xFF;       // we want rightmost byte
-        } else if (offset_in_address == 1) {
-            buf[bytes_read] = ((*(cur_datablock + position_in_file)) >> 8) & 0xFF;  // we want third byte
-        } else if (offset_in_address == 2) {
-            buf[bytes_read] = ((*(cur_datablock + position_in_file)) >> 16) & 0xFF; // we want second byte
-        } else {
-            buf[bytes_read] = (*(cur_datablock + position_in_file)) >> 24;          // we want leftmost byte
-        }
+    /* data blocks start N + 1 blocks after the boot block */
+    uint8_t* start_datablocks = (uint8_t*)the_boot_block + BLOCK_SIZE * (the_boot_block->inode_count + 1);
 
-        if (bytes_read % 4 == 3) {
-            position_in_file++;
+    /* copy block by block, jumping straight to each one through the inode */
+    uint32_t bytes_read, block, chunk;
+    for (bytes_read = 0; bytes_read < length; bytes_read += chunk) {
+        if ((offset + bytes_read) / BLOCK_SIZE >= NUM_DATA_BLOCKS) {
+            break;
         }
-        // if we reach end of current data block
-        // we increment position_in_file only once every 4 bytes
-        if (position_in_file >= BLOCK_SIZE/4) {
-            position_in_file = 0;   // reset position in file
-            num_data_block++;
-            cur_datablock_index = (uint32_t)((inode_t*) i)->data_block_num[num_data_block];
-            cur_datablock = start_datablocks + cur_datablock_index * BLOCK_SIZE/sizeof(uint32_t);
+        block = i->data_block_num[(offset + bytes_read) / BLOCK_SIZE];
+        if (block >= the_boot_block->data_block_count) {
+            return -1;      // bad inode
         }
-        // if we reach EOF (each inode can hold up to 1023 data blocks, and its 0-indexed so 0-1022) 
-        if (num_data_block > NUM_DATA_BLOCKS - 1) {
-            return 0;
+        chunk = BLOCK_SIZE - (offset + bytes_read) % BLOCK_SIZE;
+        if (chunk > length - bytes_read) {
+            chunk = length - bytes_read;
         }
+        memcpy(buf + bytes_read, start_datablocks + block * BLOCK_SIZE + (offset + bytes_read) % BLOCK_SIZE, chunk);
     }
-    /*
-    for (bytes_read = 0; bytes_read < length; bytes_read += 4) {
-        // each value in buffer is only 1B, but we read 4B at a time (in little endian format):
-        uint32_t test01 = (*(cur_datablock + position_in_file)) >> 24;              // we want leftmost byte
-        uint32_t test02 = ((*(cur_datablock + position_in_file)) >> 16) & 0xFF;     // we want second byte
-        uint32_t test03 = ((*(cur_datablock + position_in_file)) >> 8) & 0xFF;      // we want third byte
-        uint32_t test04 = ((*(cur_datablock + position_in_file))) & 0xFF;           // we want rightmost byte
-        buf[bytes_read] = test04;
-        buf[bytes_read + 1] = test03;
-        buf[bytes_read + 2] = test02;
-        buf[bytes_read + 3] = test01;
-
-        position_in_file++;
-        // if we reach end of current data block
-        // we increment position_in_file only once every 4 bytes
-        if (position_in_file >= BLOCK_SIZE/4) {
-            position_in_file = 0;   // reset position in file
-            num_data_block++;
-            cur_datablock_index = (uint32_t)((inode_t*) i)->data_block_num[num_data_block];
-            cur_datablock = start_datablocks + cur_datablock_index * BLOCK_SIZE/sizeof(uint32_t);
-        }
-        // if we reach EOF (each inode can hold up to 1023 data blocks, and its 0-indexed so 0-1022) 
-        if (num_data_block > NUM_DATA_BLOCKS - 1) {
-            return 0;
-        }
-    }
-    */
-    return bytes_read;       // divide by 4 because we want the number of bytes read, and there are 4 characters per byte
+    return bytes_read;
 }
 
-    // clear buffer
-    /*
-    int j;
-    for (j = 0; j < 1024; j++) {
-        buf[j] = '\0';
+/* file_block_addr - finds where the data block holding a byte of a file sits in memory
+ * Inputs   : inode - the inode index that indicates which file
+ *          : offset - byte of the file
+ * Outputs  : address of the 4kB block, 0 if offset is past the end of the file or the file is bad
+ * Side effects : none - the image is never written, so the block can be mapped into programs as it is
+ */
+uint32_t file_block_addr (uint32_t inode, uint32_t offset){
+    inode_t* i;
+    uint32_t block;
+
+    if (!the_boot_block || inode >= the_boot_block->inode_count) {
+        return 0;
     }
-    */
-/*
-    uint32_t bytes_read; // technically should be characters read
-    for (bytes_read = 0; bytes_read < length; bytes_read += 4) {
-        // each value in buffer is only 1B, but we read 4B at a time (in little endian format):
-        uint32_t test01 = (*(cur_datablock + position_in_file)) >> 24;              // we want leftmost byte
-        uint32_t test02 = ((*(cur_datablock + position_in_file)) >> 16) & 0xFF;     // we want second byte
-        uint32_t test03 = ((*(cur_datablock + position_in_file)) >> 8) & 0xFF;      // we want third byte
-        uint32_t test04 = ((*(cur_datablock + position_in_file))) & 0xFF;           // we want rightmost byte
-        buf[bytes_read] = test04;
-        buf[bytes_read + 1] = test03;
-        buf[bytes_read + 2] = test02;
-        buf[bytes_read + 3] = test01;
-
-        position_in_file++;
-        // if we reach end of current data block //
-        // we increment position_in_file only once every 4 bytes
-        if (position_in_file >= BLOCK_SIZE/4) {
-            position_in_file = 0;   // reset position in file
-            num_data_block++;
-            cur_datablock_index = (uint32_t)((inode_t*) i)->data_block_num[num_data_block];
-            cur_datablock = start_datablocks + cur_datablock_index * BLOCK_SIZE/sizeof(uint32_t);
-        }
-        // if we reach EOF (each inode can hold up to 1023 data blocks, and its 0-indexed so 0-1022) //
-        if (num_data_block > NUM_DATA_BLOCKS - 1) {
-            return 0;
-        }
+
+    i = (inode_t*)((uint32_t)the_boot_block + BLOCK_SIZE * (inode + 1));
+    if (offset >= i->length || offset / BLOCK_SIZE >= NUM_DATA_BLOCKS) {
+        return 0;
     }
-    return bytes_read;
+
+    block = i->data_block_num[offset / BLOCK_SIZE];
+    if (block >= the_boot_block->data_block_count) {
+        return 0;
+    }
+    return (uint32_t)the_boot_block + BLOCK_SIZE * (the_boot_block->inode_count + 1 + block);
 }
-    */
 
 
 /* Local functions defined
@@ -280,21 +215,31 @@ int32_t file_read(int32_t fd, void* buf, int32_t nbytes){
     /* Fetch inode idx and offset into file using fda array*/
     pcb_t* curr_pcb = get_pcb_ptr();
     uint32_t offset = (curr_pcb->fda[fd].file_position);
-
-    /* Check if file position of fd is at or beyond end of file */
     uint32_t i = curr_pcb->fda[fd].inode;
-    uint32_t file_length = ((inode_t*)(fs_start_addr + (i + 1) * BLOCK_SIZE))->length;
-    /* Return 0 if file_position at or beyond length of file */
-    if (offset >= file_length && file_length != 0){
-        return 0;
+
+    if (nbytes < 0){
+        return -1;
+    }
+
+    /* read_data returns 0 if file_position is at or beyond the end of the file (lseek can put it there) */
+    int32_t bytes_read = read_data(i, offset, buf, nbytes);
+    if (bytes_read == -1){
+        return -1;
     }
-    
-    uint32_t bytes_read = read_data(i, offset, buf, nbytes);   // start at offset 0 because we want the whole file
     /*Update file position */
     curr_pcb->fda[fd].file_position += bytes_read;
 
-    /* call read_data with args */
-    return bytes_read;   // start at offset 0 because we want the whole file
+    return bytes_read;
+}
+
+/* int32_t file_length(int32_t fd) - length of an open file
+ * Inputs   : fd - file descriptor of a regular file
+ * Outputs  : length in bytes
+ */
+int32_t file_length(int32_t fd){
+    pcb_t* curr_pcb = get_pcb_ptr();
+
+    return ((inode_t*)((uint32_t)the_boot_block + BLOCK_SIZE * (curr_pcb->fda[fd].inode + 1)))->length;
 }
 
 /* file_write - doesn't do anything for this checkpoint
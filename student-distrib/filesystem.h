@@ -63,6 +63,7 @@ int global_file_index;      // used for dir_read
 uint32_t read_dentry_by_name (const int8_t* fname, dentry_t* dentry);
 uint32_t read_dentry_by_index (uint32_t index, dentry_t* dentry);
 uint32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+uint32_t file_block_addr (uint32_t inode, uint32_t offset);
 
 /* local functions - function params based on declarations in ece391syscall.h */
 uint32_t init_file_system(uint32_t fs_start, uint32_t fs_end);
@@ -70,6 +71,7 @@ int32_t file_open(const uint8_t* filename);
 int32_t file_close(int32_t fd);
 int32_t file_read(int32_t fd, void* buf, int32_t nbytes);
 int32_t file_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t file_length(int32_t fd);
 int32_t dir_open(const uint8_t* filename);
 int32_t dir_close(int32_t fd);
 int32_t dir_read(int32_t fd, void* buf, int32_t nbytes);
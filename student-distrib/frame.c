@@ -0,0 +1,193 @@
+/* frame.c - Physical page frame allocator: a buddy allocator over the RAM the multiboot memory map reports
+ *
+ * A free block of 2^k frames is aligned to 2^k frames (counted from FRAME_BASE) and sits on free_lists[k],
+ * linked through its own first bytes. Its buddy is the block it was split from the other half of; when both
+ * halves are free again they merge back into one block of order k + 1.
+ */
+
+#include "frame.h"
+#include "lib.h"
+
+typedef struct free_block {
+    struct free_block* next;
+    struct free_block* prev;
+} free_block_t;
+
+static free_block_t* free_lists[FRAME_MAX_ORDER + 1];
+static uint8_t frame_state[FRAME_COUNT];
+
+#define FRAME_IDX(addr)     (((addr) - FRAME_BASE) >> FRAME_SHIFT)
+#define FRAME_ADDR(idx)     (FRAME_BASE + ((idx) << FRAME_SHIFT))
+
+/* free_list_push / free_list_remove
+ * Inputs: idx - first frame of the block
+ *         order - size of the block
+ * Outputs: none
+ * Side Effects: keeps frame_state[idx] in step with the lists
+ */
+static void free_list_push(uint32_t idx, int order){
+    free_block_t* block = (free_block_t*)FRAME_ADDR(idx);
+
+    block->prev = NULL;
+    block->next = free_lists[order];
+    if(block->next != NULL){
+        block->next->prev = block;
+    }
+    free_lists[order] = block;
+    frame_state[idx] = FRAME_FREE | order;
+}
+
+static void free_list_remove(uint32_t idx, int order){
+    free_block_t* block = (free_block_t*)FRAME_ADDR(idx);
+
+    if(block->prev != NULL){
+        block->prev->next = block->next;
+    }
+    else{
+        free_lists[order] = block->next;
+    }
+    if(block->next != NULL){
+        block->next->prev = block->prev;
+    }
+    frame_state[idx] = 0;
+}
+
+/* frame_add_range(uint32_t start, uint32_t end, multiboot_info_t* mbi)
+ * Frees every frame of a usable RAM range that the allocator covers, skipping the boot modules
+ * Inputs: start, end - physical range [start, end)
+ *         mbi - for the module list
+ * Outputs: none
+ * Side Effects: none
+ */
+static void frame_add_range(uint32_t start, uint32_t end, multiboot_info_t* mbi){
+    module_t* mod;
+    uint32_t addr, i;
+    int in_module;
+
+    if(start < FRAME_BASE) start = FRAME_BASE;
+    if(end > FRAME_LIMIT) end = FRAME_LIMIT;
+    start = (start + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1);
+    end &= ~(FRAME_SIZE - 1);
+
+    for(addr = start; addr < end; addr += FRAME_SIZE){
+        // the filesystem image is a module, and it has to stay where GRUB put it
+        in_module = 0;
+        if(mbi->flags & MULTIBOOT_INFO_MODS){
+            mod = (module_t*)mbi->mods_addr;
+            for(i = 0; i < mbi->mods_count; i++, mod++){
+                if(addr + FRAME_SIZE > mod->mod_start && addr < mod->mod_end){
+                    in_module = 1;
+                }
+            }
+        }
+        if(in_module){
+            continue;
+        }
+
+        frames_total++;
+        frame_free(addr, 0);
+    }
+}
+
+/* frame_init(multiboot_info_t* mbi)
+ * Builds the free lists from the memory map, or from mem_upper if the bootloader didn't give us a map
+ * Inputs: mbi - multiboot information from the bootloader
+ * Outputs: none
+ * Side Effects: writes list links into every free frame, has to run before paging so the map is reachable
+ */
+void frame_init(multiboot_info_t* mbi){
+    memory_map_t* mmap;
+    uint32_t end;
+    int i;
+
+    for(i = 0; i <= FRAME_MAX_ORDER; i++){
+        free_lists[i] = NULL;
+    }
+    memset(frame_state, 0, sizeof(frame_state));
+    frames_total = 0;
+    frames_free = 0;
+
+    if(mbi->flags & MULTIBOOT_INFO_MMAP){
+        for(mmap = (memory_map_t*)mbi->mmap_addr;
+                (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+                mmap = (memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size))){
+            // only RAM below 4GB, and the part of a range that wraps past 4GB is cut off
+            if(mmap->type != MULTIBOOT_MMAP_RAM || mmap->base_addr_high != 0){
+                continue;
+            }
+            end = mmap->base_addr_low + mmap->length_low;
+            if(mmap->length_high != 0 || end < mmap->base_addr_low){
+                end = 0xFFFFF000;
+            }
+            frame_add_range(mmap->base_addr_low, end, mbi);
+        }
+    }
+    else if(mbi->flags & MULTIBOOT_INFO_MEM){
+        // mem_upper is the KB of contiguous RAM starting at 1MB
+        frame_add_range(0x100000, 0x100000 + (mbi->mem_upper << 10), mbi);
+    }
+}
+
+/* frame_alloc(int order)
+ * Takes the smallest free block that fits and splits it down to the requested size
+ * Inputs: order - allocate 2^order frames
+ * Outputs: physical address of the block (the kernel can use it as is), 0 if none is free
+ * Side Effects: the memory is not cleared
+ */
+uint32_t frame_alloc(int order){
+    uint32_t idx, flags;
+    int k;
+
+    if(order < 0 || order > FRAME_MAX_ORDER){
+        return 0;
+    }
+
+    cli_and_save(flags);
+    for(k = order; k <= FRAME_MAX_ORDER && free_lists[k] == NULL; k++);
+    if(k > FRAME_MAX_ORDER){
+        restore_flags(flags);
+        return 0;
+    }
+
+    idx = FRAME_IDX((uint32_t)free_lists[k]);
+    free_list_remove(idx, k);
+
+    // the upper halves of what is left over go back on the smaller lists
+    while(k > order){
+        k--;
+        free_list_push(idx + (1 << k), k);
+    }
+
+    frames_free -= 1 << order;
+    restore_flags(flags);
+    return FRAME_ADDR(idx);
+}
+
+/* frame_free(uint32_t addr, int order)
+ * Inputs: addr - block from frame_alloc
+ *         order - the order it was allocated with
+ * Outputs: none
+ * Side Effects: merges with the buddy for as long as the buddy is a free block of the same size
+ */
+void frame_free(uint32_t addr, int order){
+    uint32_t idx, buddy, flags;
+
+    if(addr < FRAME_BASE || addr >= FRAME_LIMIT){
+        return;
+    }
+
+    cli_and_save(flags);
+    frames_free += 1 << order;
+    idx = FRAME_IDX(addr);
+    while(order < FRAME_MAX_ORDER){
+        buddy = idx ^ (1 << order);
+        if(buddy >= FRAME_COUNT || frame_state[buddy] != (FRAME_FREE | order)){
+            break;
+        }
+        free_list_remove(buddy, order);
+        idx &= ~(1 << order);
+        order++;
+    }
+    free_list_push(idx, order);
+    restore_flags(flags);
+}
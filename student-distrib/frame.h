@@ -0,0 +1,34 @@
+/* frame.h - Physical page frame allocator: a buddy allocator over the RAM the multiboot memory map reports
+ */
+
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include "types.h"
+#include "multiboot.h"
+
+#define FRAME_SIZE          0x1000
+#define FRAME_SHIFT         12
+#define FRAME_BASE          0x00800000      // frames start above the kernel and its stacks (4-8MB)
+#define FRAME_LIMIT         0x08000000      // and stop where user space begins, so the kernel reaches them all through its identity map
+#define FRAME_COUNT         ((FRAME_LIMIT - FRAME_BASE) >> FRAME_SHIFT)
+#define FRAME_MAX_ORDER     10              // largest block is 2^10 frames (4MB)
+
+// frame_state[] - the first frame of a free block is FRAME_FREE | order, every other frame is 0
+#define FRAME_FREE          0x80
+#define FRAME_ORDER_MASK    0x0F
+
+// number of frames the allocator manages, and how many of them are free right now
+uint32_t frames_total;
+uint32_t frames_free;
+
+// hands every usable frame in the memory map to the allocator - runs before paging, while the map is still reachable
+void frame_init(multiboot_info_t* mbi);
+
+// allocates 2^order physically contiguous frames, returns their address (identity mapped) or 0 if there is no such block
+uint32_t frame_alloc(int order);
+
+// gives back a block from frame_alloc, merging it with its free buddies
+void frame_free(uint32_t addr, int order);
+
+#endif /* _FRAME_H */
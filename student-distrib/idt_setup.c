@@ -46,6 +46,9 @@ void idt_setup() {
     SET_IDT_ENTRY(idt[0x20], PIT_INTERRUPT);
     SET_IDT_ENTRY(idt[0x21], KEYBOARD_INTERRUPT);
     SET_IDT_ENTRY(idt[0x28], RTC_INTERRUPT);
+    SET_IDT_ENTRY(idt[LAPIC_TIMER_VEC], LAPIC_TIMER_INTERRUPT);
+    SET_IDT_ENTRY(idt[LAPIC_RESCHED_VEC], RESCHED_INTERRUPT);
+    SET_IDT_ENTRY(idt[LAPIC_SPURIOUS_VEC], SPURIOUS_INTERRUPT);
     
     //System call entry
     SET_IDT_ENTRY(idt[0x80], SYSTEM_CALL_WRAPPER);
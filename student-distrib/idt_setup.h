@@ -2,6 +2,7 @@
 #define _IDT_SETUP_H
 
 #include "x86_desc.h"
+#include "lapic.h"
 
 /* sets up and fills interrupt descriptor table entries/gates */
 void idt_setup(void);
@@ -0,0 +1,43 @@
+/* ioring.h - Submission and completion rings a program shares with the kernel, to batch system calls
+ */
+
+#ifndef _IORING_H
+#define _IORING_H
+
+#include "types.h"
+
+#define IORING_SQ_ENTRIES   64          // powers of two: the indexes run freely and are masked
+#define IORING_CQ_ENTRIES   128         // room for two full batches the program hasn't reaped yet
+
+// what a submission asks for - each one is the system call of the same name
+#define IORING_OP_NOP       0
+#define IORING_OP_READ      1
+#define IORING_OP_WRITE     2
+#define IORING_OP_OPEN      3
+#define IORING_OP_CLOSE     4
+
+typedef struct io_sqe {
+    uint32_t user_data;                 // handed back in the completion
+    uint16_t op;                        // IORING_OP_*
+    int16_t fd;
+    uint32_t addr;                      // the buffer, or the file name for OPEN
+    int32_t len;
+} io_sqe_t;
+
+typedef struct io_cqe {
+    uint32_t user_data;
+    int32_t res;                        // what the system call returned
+} io_cqe_t;
+
+// the page both sides see - user programs have a copy of this in ece391syscall.h
+typedef struct io_ring {
+    uint32_t sq_head;                   // written by the kernel: submissions up to here are taken
+    uint32_t sq_tail;                   // written by the program: submissions up to here are ready
+    uint32_t cq_head;                   // written by the program: completions up to here are reaped
+    uint32_t cq_tail;                   // written by the kernel: completions up to here are filled in
+    uint32_t reserved[12];              // the entries start on their own cache line
+    io_sqe_t sqes[IORING_SQ_ENTRIES];
+    io_cqe_t cqes[IORING_CQ_ENTRIES];
+} io_ring_t;
+
+#endif /* _IORING_H */
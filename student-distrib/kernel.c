@@ -15,6 +15,10 @@
 #include "types.h"
 #include "syscall.h"
 #include "schedule.h"
+#include "smp.h"
+#include "clock.h"
+#include "frame.h"
+#include "kmalloc.h"
 //#define RUN_TESTS
 
 /* Macros. */
@@ -121,39 +125,30 @@ void entry(unsigned long magic, unsigned long addr) {
         lldt(KERNEL_LDT);
     }
 
-    /* Construct a TSS entry in the GDT */
-    {
-        seg_desc_t the_tss_desc;
-        the_tss_desc.granularity   = 0x0;
-        the_tss_desc.opsize        = 0x0;
-        the_tss_desc.reserved      = 0x0;
-        the_tss_desc.avail         = 0x0;
-        the_tss_desc.seg_lim_19_16 = TSS_SIZE & 0x000F0000;
-        the_tss_desc.present       = 0x1;
-        the_tss_desc.dpl           = 0x0;
-        the_tss_desc.sys           = 0x0;
-        the_tss_desc.type          = 0x9;
-        the_tss_desc.seg_lim_15_00 = TSS_SIZE & 0x0000FFFF;
-
-        SET_TSS_PARAMS(the_tss_desc, &tss, tss_size);
-
-        tss_desc_ptr = the_tss_desc;
-
-        tss.ldt_segment_selector = KERNEL_LDT;
-        tss.ss0 = KERNEL_DS;
-        tss.esp0 = 0x800000;
-        ltr(KERNEL_TSS);
-    }
+    /* Construct the boot processor's TSS entry in the GDT, and load it */
+    cpu_tss_init(0, 0x800000);
 
     /* Init the PIC */
     i8259_init();
 
+    /* Hand the free RAM to the frame allocator while the memory map is still reachable */
+    frame_init(mbi);
+    printf("Memory: %d kB in %d page frames free\n", frames_free * 4, frames_free);
+    kmem_init();
+
+    /* Find and start the other processors while low memory is still reachable */
+    smp_init();
+    printf("SMP: %d CPU(s) found, %d online\n", num_cpus, cpus_online);
+
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
     init_paging();
 
     rtc_init();
 
+    /* TSC clock and wall clock, before anything wants a timestamp */
+    clock_init();
+
     keyboard_init();
 
     syscall_init();
@@ -162,7 +157,7 @@ void entry(unsigned long magic, unsigned long addr) {
 
     initial_boot();
 
-    init_PIT();
+    init_timer();
 
     // boot_terminals();
     /* Enable interrupts */
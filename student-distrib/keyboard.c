@@ -133,12 +133,18 @@ void keyboard_handler(void){
     // sti();
 
     // if CTRL+C and process (par 1st shell) is running, cancel that
-    if(running_flag == 1 && call_halt == 1){
+    // (not while idling - there is no process to halt then, call_halt stays set for the next key)
+    if(running_flag == 1 && call_halt == 1 && curr_pid != IDLE_PID){
         // indicate the process no longer running
         running_flag = 0;
         call_halt = 0;
         sys_halt(-1);
     }
+
+    // enter woke up the foreground reader - switch to it now instead of waiting for the PIT
+    if(need_resched){
+        schedule();
+    }
 }
 
 /*
@@ -172,7 +178,7 @@ void process_key(uint8_t scancode){
 
     if(ctrl_pressed){
         // clear screen if CTRL+L or CTRL+l
-        if(scancode == L){
+        if(scancode == L_KEY){
             clear();                    // clear screen from lib.c
             
             // if shell is running, print 391OS>
@@ -188,7 +194,7 @@ void process_key(uint8_t scancode){
         }
 
         // cancel current program
-        if(scancode == C){
+        if(scancode == C_KEY){
             // sys_halt(-1);       // -1 since we are terminating process before it can finish
             call_halt = 1;
         }
@@ -342,6 +348,7 @@ void keyboard_return(void){
     // tell terminal driver that '\n' was pressed
     // key_flag = 1;
     terminals[curr_term].key_flag = 1;      // tell current terminal that enter was pressed
+    wq_wake_up_preempt(&terminals[curr_term].read_wq);  // and wake up whoever is blocked reading it, ahead of the running task
 
     terminals[curr_term].ac_repeats = 0;    // reset repeats
 
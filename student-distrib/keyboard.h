@@ -25,8 +25,8 @@
 #define ALT 0x38
 #define ALT_RELEASE 0xB8
 #define ENTER 0x1C
-#define L 0x26
-#define C 0x2E
+#define L_KEY 0x26
+#define C_KEY 0x2E
 #define BACKSPACE 0x0E
 #define TAB 0x0F
 #define TAB_RELEASE 0x8F
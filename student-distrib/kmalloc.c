@@ -0,0 +1,286 @@
+/* kmalloc.c - Kernel heap: slab caches for small objects, page frames for large ones
+ *
+ * Requests up to KMEM_MAX_SIZE are rounded up to a power of two size class. Each class carves single frames
+ * (slabs) into objects of its size: the slab header sits at the start of the frame, the objects follow at an
+ * offset aligned to their size, and free objects are linked through their first word. A class keeps its slabs
+ * that still have room on a partial list, so alloc and free are O(1). Bigger requests get a buddy block of
+ * frames of their own. kmem_pages[] records which of the two a frame is, which is how kfree tells them apart.
+ */
+
+#include "kmalloc.h"
+#include "frame.h"
+#include "lib.h"
+
+typedef struct slab {
+    struct slab* next;                  // on the class' partial or full list
+    struct slab* prev;
+    void* free;                         // first free object
+    uint16_t cls;
+    uint16_t in_use;
+} slab_t;
+
+typedef struct kmem_class {
+    slab_t* partial;                    // slabs with at least one free object (empty ones included)
+    slab_t* full;
+    uint32_t offset;                    // where the first object starts in a slab
+    uint32_t per_slab;                  // objects in a slab
+    uint32_t empty;                     // slabs on the partial list with nothing allocated
+    kmem_class_stats_t stats;
+} kmem_class_t;
+
+static kmem_class_t classes[KMEM_CLASSES];
+static uint8_t kmem_pages[FRAME_COUNT];
+static kmem_stats_t totals;             // everything but the per class stats
+
+#define PAGE_IDX(addr)      (((uint32_t)(addr) - FRAME_BASE) >> FRAME_SHIFT)
+
+/* slab_list_push / slab_list_remove
+ * Inputs: list - head of the list
+ *         slab - slab to link in or out
+ * Outputs: none
+ * Side Effects: none
+ */
+static void slab_list_push(slab_t** list, slab_t* slab){
+    slab->prev = NULL;
+    slab->next = *list;
+    if(slab->next != NULL){
+        slab->next->prev = slab;
+    }
+    *list = slab;
+}
+
+static void slab_list_remove(slab_t** list, slab_t* slab){
+    if(slab->prev != NULL){
+        slab->prev->next = slab->next;
+    }
+    else{
+        *list = slab->next;
+    }
+    if(slab->next != NULL){
+        slab->next->prev = slab->prev;
+    }
+}
+
+/* size_to_class(uint32_t size)
+ * Inputs: size - 1 to KMEM_MAX_SIZE bytes
+ * Outputs: smallest class whose objects fit size bytes
+ */
+static int size_to_class(uint32_t size){
+    uint32_t bit;
+
+    if(size <= (1 << KMEM_MIN_SHIFT)){
+        return 0;
+    }
+    asm ("bsrl %1, %0" : "=r"(bit) : "rm"(size - 1) : "cc");
+    return bit + 1 - KMEM_MIN_SHIFT;
+}
+
+/* kmem_init()
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: every class starts without slabs
+ */
+void kmem_init(void){
+    kmem_class_t* c;
+    uint32_t size;
+    int i;
+
+    memset(classes, 0, sizeof(classes));
+    memset(kmem_pages, 0, sizeof(kmem_pages));
+    memset(&totals, 0, sizeof(totals));
+
+    for(i = 0; i < KMEM_CLASSES; i++){
+        c = &classes[i];
+        size = 1 << (KMEM_MIN_SHIFT + i);
+        // keeping objects aligned to their size costs nothing: the header only ever takes part of one object's room
+        c->offset = (sizeof(slab_t) + size - 1) & ~(size - 1);
+        c->per_slab = (FRAME_SIZE - c->offset) / size;
+        c->stats.size = size;
+    }
+}
+
+/* slab_create(int cls)
+ * Inputs: cls - class to make a slab for
+ * Outputs: a slab with all objects free, NULL if there are no frames left
+ * Side Effects: none
+ */
+static slab_t* slab_create(int cls){
+    kmem_class_t* c = &classes[cls];
+    slab_t* slab;
+    uint8_t* obj;
+    uint32_t i;
+
+    slab = (slab_t*)frame_alloc(0);
+    if(slab == NULL){
+        return NULL;
+    }
+
+    slab->cls = cls;
+    slab->in_use = 0;
+    slab->free = NULL;
+    // link them back to front so the first allocation gets the lowest object
+    obj = (uint8_t*)slab + c->offset + (c->per_slab - 1) * c->stats.size;
+    for(i = 0; i < c->per_slab; i++, obj -= c->stats.size){
+        *(void**)obj = slab->free;
+        slab->free = obj;
+    }
+
+    kmem_pages[PAGE_IDX(slab)] = KMEM_PAGE_SLAB;
+    c->stats.slabs++;
+    c->stats.objects += c->per_slab;
+    c->empty++;
+    totals.bytes_held += FRAME_SIZE;
+    return slab;
+}
+
+/* slab_destroy(slab_t* slab)
+ * Inputs: slab - an empty slab that is on no list
+ * Outputs: none
+ * Side Effects: its frame goes back to the frame allocator
+ */
+static void slab_destroy(slab_t* slab){
+    kmem_class_t* c = &classes[slab->cls];
+
+    kmem_pages[PAGE_IDX(slab)] = 0;
+    c->stats.slabs--;
+    c->stats.objects -= c->per_slab;
+    c->empty--;
+    totals.bytes_held -= FRAME_SIZE;
+    frame_free((uint32_t)slab, 0);
+}
+
+/* kmalloc(uint32_t size)
+ * Inputs: size - bytes wanted
+ * Outputs: the memory (not cleared), NULL if size is 0 or there is no memory left
+ * Side Effects: may take frames from the frame allocator
+ */
+void* kmalloc(uint32_t size){
+    kmem_class_t* c;
+    slab_t* slab;
+    void* obj;
+    uint32_t flags, block;
+    int cls, order;
+
+    if(size == 0){
+        return NULL;
+    }
+
+    cli_and_save(flags);
+    totals.nr_allocs++;
+
+    if(size > KMEM_MAX_SIZE){
+        for(order = 0; order <= FRAME_MAX_ORDER && (FRAME_SIZE << order) < size; order++);
+        block = frame_alloc(order);     // 0 for an order above the max too
+        if(block != 0){
+            kmem_pages[PAGE_IDX(block)] = KMEM_PAGE_LARGE | order;
+            totals.large_blocks++;
+            totals.bytes_in_use += FRAME_SIZE << order;
+            totals.bytes_held += FRAME_SIZE << order;
+        }
+        restore_flags(flags);
+        return (void*)block;
+    }
+
+    cls = size_to_class(size);
+    c = &classes[cls];
+    slab = c->partial;
+    if(slab == NULL){
+        slab = slab_create(cls);
+        if(slab == NULL){
+            restore_flags(flags);
+            return NULL;
+        }
+        slab_list_push(&c->partial, slab);
+    }
+
+    obj = slab->free;
+    slab->free = *(void**)obj;
+    if(slab->in_use++ == 0){
+        c->empty--;
+    }
+    if(slab->free == NULL){
+        slab_list_remove(&c->partial, slab);
+        slab_list_push(&c->full, slab);
+    }
+
+    c->stats.in_use++;
+    totals.bytes_in_use += c->stats.size;
+    restore_flags(flags);
+    return obj;
+}
+
+/* kfree(void* ptr)
+ * Inputs: ptr - memory from kmalloc, or NULL
+ * Outputs: none
+ * Side Effects: a slab that becomes empty goes back to the frame allocator once its class has enough empty ones
+ */
+void kfree(void* ptr){
+    kmem_class_t* c;
+    slab_t* slab;
+    uint32_t flags, order;
+    uint8_t page;
+
+    if((uint32_t)ptr < FRAME_BASE || (uint32_t)ptr >= FRAME_LIMIT){
+        return;
+    }
+
+    cli_and_save(flags);
+    page = kmem_pages[PAGE_IDX(ptr)];
+
+    if(page & KMEM_PAGE_LARGE){
+        order = page & KMEM_ORDER_MASK;
+        kmem_pages[PAGE_IDX(ptr)] = 0;
+        totals.nr_frees++;
+        totals.large_blocks--;
+        totals.bytes_in_use -= FRAME_SIZE << order;
+        totals.bytes_held -= FRAME_SIZE << order;
+        frame_free((uint32_t)ptr, order);
+        restore_flags(flags);
+        return;
+    }
+    if(!(page & KMEM_PAGE_SLAB)){
+        // not ours
+        restore_flags(flags);
+        return;
+    }
+
+    slab = (slab_t*)((uint32_t)ptr & ~(FRAME_SIZE - 1));
+    c = &classes[slab->cls];
+
+    if(slab->free == NULL){
+        slab_list_remove(&c->full, slab);
+        slab_list_push(&c->partial, slab);
+    }
+    *(void**)ptr = slab->free;
+    slab->free = ptr;
+
+    totals.nr_frees++;
+    c->stats.in_use--;
+    totals.bytes_in_use -= c->stats.size;
+
+    if(--slab->in_use == 0){
+        c->empty++;
+        if(c->empty > KMEM_EMPTY_MAX){
+            slab_list_remove(&c->partial, slab);
+            slab_destroy(slab);
+        }
+    }
+    restore_flags(flags);
+}
+
+/* kmem_get_stats(kmem_stats_t* stats)
+ * Inputs: stats - where to copy the statistics
+ * Outputs: none
+ * Side Effects: none
+ */
+void kmem_get_stats(kmem_stats_t* stats){
+    uint32_t flags;
+    int i;
+
+    cli_and_save(flags);
+    *stats = totals;
+    for(i = 0; i < KMEM_CLASSES; i++){
+        stats->classes[i] = classes[i].stats;
+    }
+    restore_flags(flags);
+}
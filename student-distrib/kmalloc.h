@@ -0,0 +1,51 @@
+/* kmalloc.h - Kernel heap: slab caches for small objects, page frames for large ones
+ */
+
+#ifndef _KMALLOC_H
+#define _KMALLOC_H
+
+#include "types.h"
+
+#define KMEM_MIN_SHIFT      4                   // smallest class is 16 bytes
+#define KMEM_CLASSES        7                   // 16, 32, ... 1024 bytes
+#define KMEM_MAX_SIZE       (1 << (KMEM_MIN_SHIFT + KMEM_CLASSES - 1))  // bigger requests get whole frames
+#define KMEM_EMPTY_MAX      1                   // empty slabs a class keeps before giving frames back
+
+// kmem_pages[] - what a frame is being used for by the heap
+#define KMEM_PAGE_SLAB      0x40
+#define KMEM_PAGE_LARGE     0x80                // first frame of a large block, | its order
+#define KMEM_ORDER_MASK     0x0F
+
+// occupancy of one size class
+typedef struct kmem_class_stats {
+    uint32_t size;                      // object size
+    uint32_t slabs;                     // slabs (one frame each) the class holds
+    uint32_t objects;                   // objects those slabs have room for
+    uint32_t in_use;                    // objects allocated right now
+} kmem_class_stats_t;
+
+// filled in by kmem_get_stats - user programs have a copy of this in ece391syscall.h
+typedef struct kmem_stats {
+    uint32_t bytes_in_use;              // bytes handed out, rounded up to the class size or to whole frames
+    uint32_t bytes_held;                // bytes taken from the frame allocator - the difference is fragmentation
+    uint32_t large_blocks;              // large allocations right now
+    uint32_t nr_allocs;                 // calls since boot
+    uint32_t nr_frees;
+    uint32_t tlb_full_flushes;          // paging counters, filled in by the kmemstats system call
+    uint32_t tlb_page_flushes;
+    kmem_class_stats_t classes[KMEM_CLASSES];
+} kmem_stats_t;
+
+// empties the slab caches, called once the frame allocator is up
+void kmem_init(void);
+
+// allocates size bytes, aligned to the class size (frame aligned for large blocks), NULL if out of memory
+void* kmalloc(uint32_t size);
+
+// gives back memory from kmalloc, NULL is ignored
+void kfree(void* ptr);
+
+// copies the heap statistics
+void kmem_get_stats(kmem_stats_t* stats);
+
+#endif /* _KMALLOC_H */
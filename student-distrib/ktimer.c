@@ -0,0 +1,244 @@
+/* ktimer.c - Kernel timers: callbacks run off the scheduler tick, kept in a hierarchical timing wheel
+ *
+ * Level 0 has one slot per tick for the next 64 ticks, level 1 one slot per 64 ticks for the next 64^2,
+ * and so on. Adding or deleting a timer is O(1). Every 64 ticks the level 1 slot that has come due is
+ * emptied into level 0 (and every 64^2 ticks a level 2 slot into level 1, ...), so a timer is moved at
+ * most WHEEL_LEVELS - 1 times before it fires.
+ *
+ * Each processor keeps its own wheel and runs it off its own clock, so a timer fires on the processor
+ * it was armed on and its expiry is always measured in that processor's ticks.
+ */
+
+#include "ktimer.h"
+#include "schedule.h"
+#include "smp.h"
+
+/* wheel_insert(ktimer_wheel_t* wheel, ktimer_t* timer)
+ * Links a timer into the slot its expiry falls in, relative to the wheel's clock
+ * Inputs: wheel - wheel to put it on
+ *         timer - timer with expires set, not on any wheel
+ * Outputs: none
+ * Side Effects: none
+ */
+static void wheel_insert(ktimer_wheel_t* wheel, ktimer_t* timer){
+    uint32_t delta = timer->expires - wheel->clock;
+    int level;
+
+    for(level = 0; level < WHEEL_LEVELS - 1 && delta >= (1U << (WHEEL_BITS * (level + 1))); level++);
+
+    timer->wheel = wheel;
+    timer->slot = &wheel->slots[level][(timer->expires >> (WHEEL_BITS * level)) & WHEEL_MASK];
+    timer->prev = NULL;
+    timer->next = *timer->slot;
+    if(timer->next != NULL){
+        timer->next->prev = timer;
+    }
+    *timer->slot = timer;
+    wheel->level_count[level]++;
+    wheel->count++;
+}
+
+/* wheel_unlink(ktimer_t* timer)
+ * Takes a pending timer off its slot
+ * Inputs: timer - a pending timer
+ * Outputs: none
+ * Side Effects: the timer is no longer pending
+ */
+static void wheel_unlink(ktimer_t* timer){
+    ktimer_wheel_t* wheel = timer->wheel;
+
+    if(timer->prev != NULL){
+        timer->prev->next = timer->next;
+    }
+    else{
+        *timer->slot = timer->next;
+    }
+    if(timer->next != NULL){
+        timer->next->prev = timer->prev;
+    }
+
+    wheel->level_count[(timer->slot - &wheel->slots[0][0]) / WHEEL_SIZE]--;
+    wheel->count--;
+    timer->slot = NULL;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+/* wheel_cascade(ktimer_wheel_t* wheel, int level)
+ * Moves the timers of the level's slot that has just come due one level down (or further)
+ * Inputs: wheel - wheel being run
+ *         level - 1 to WHEEL_LEVELS - 1
+ * Outputs: the index of that slot, 0 means the next level up is due as well
+ * Side Effects: none
+ */
+static int wheel_cascade(ktimer_wheel_t* wheel, int level){
+    int index = (wheel->clock >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    ktimer_t* timer;
+
+    while((timer = wheel->slots[level][index]) != NULL){
+        wheel_unlink(timer);
+        wheel_insert(wheel, timer);
+    }
+    return index;
+}
+
+/* wheel_find_next(ktimer_wheel_t* wheel)
+ * Recomputes the wheel's next expiry by looking at every pending timer
+ * Inputs: wheel - wheel being run
+ * Outputs: none
+ * Side Effects: only needed after the earliest timer fired, not on every tick
+ */
+static void wheel_find_next(ktimer_wheel_t* wheel){
+    uint32_t earliest = WHEEL_MAX_TICKS;
+    ktimer_t* timer;
+    int level, index;
+
+    for(level = 0; level < WHEEL_LEVELS; level++){
+        if(wheel->level_count[level] == 0){
+            continue;
+        }
+        for(index = 0; index < WHEEL_SIZE; index++){
+            for(timer = wheel->slots[level][index]; timer != NULL; timer = timer->next){
+                if(timer->expires - wheel->clock < earliest){
+                    earliest = timer->expires - wheel->clock;
+                }
+            }
+        }
+    }
+    wheel->next = wheel->clock + earliest;
+}
+
+/* ktimer_init_wheel(ktimer_wheel_t* wheel, uint32_t now)
+ * Inputs: wheel - a processor's wheel
+ *         now - that processor's current tick
+ * Outputs: none
+ * Side Effects: drops every pending timer, the wheel starts at now
+ */
+void ktimer_init_wheel(ktimer_wheel_t* wheel, uint32_t now){
+    int level, index;
+
+    for(level = 0; level < WHEEL_LEVELS; level++){
+        for(index = 0; index < WHEEL_SIZE; index++){
+            wheel->slots[level][index] = NULL;
+        }
+        wheel->level_count[level] = 0;
+    }
+    wheel->count = 0;
+    wheel->clock = now;
+    wheel->next = now;
+}
+
+/* ktimer_setup(ktimer_t* timer, ktimer_fn_t fn, void* data)
+ * Inputs: timer - timer to set up
+ *         fn - what to call when it fires
+ *         data - for fn, in timer->data
+ * Outputs: none
+ * Side Effects: the timer is not pending
+ */
+void ktimer_setup(ktimer_t* timer, ktimer_fn_t fn, void* data){
+    timer->fn = fn;
+    timer->data = data;
+    timer->wheel = NULL;
+    timer->slot = NULL;
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->expires = 0;
+}
+
+/* ktimer_add(ktimer_t* timer, uint32_t ticks)
+ * Arms a timer on this processor's wheel, or moves it there if it is already pending
+ * Inputs: timer - timer set up with ktimer_setup
+ *         ticks - scheduler ticks from now, at least 1 and at most WHEEL_MAX_TICKS
+ * Outputs: none
+ * Side Effects: makes sure the timer interrupt comes in time even while tickless, call with interrupts off
+ */
+void ktimer_add(ktimer_t* timer, uint32_t ticks){
+    cpu_t* cpu = this_cpu();
+    ktimer_wheel_t* wheel = &cpu->timers;
+
+    if(ktimer_pending(timer)){
+        wheel_unlink(timer);
+    }
+
+    if(ticks == 0){
+        ticks = 1;
+    }
+    if(ticks > WHEEL_MAX_TICKS){
+        ticks = WHEEL_MAX_TICKS;
+    }
+
+    // in the middle of a one-shot the tick count lags behind, so catch it up first or the timer fires early
+    tick_sync();
+    timer->expires = cpu->ticks + ticks;
+    wheel_insert(wheel, timer);
+
+    if(wheel->count == 1 || (int32_t)(timer->expires - wheel->next) < 0){
+        wheel->next = timer->expires;
+    }
+    tick_request(wheel->next);
+
+    // a one-shot already armed for a later deadline has to be shortened
+    if(cpu->tickless){
+        tick_update();
+    }
+}
+
+/* ktimer_del(ktimer_t* timer)
+ * Inputs: timer - timer to disarm
+ * Outputs: none
+ * Side Effects: none if it isn't pending, call with interrupts off
+ */
+void ktimer_del(ktimer_t* timer){
+    if(ktimer_pending(timer)){
+        wheel_unlink(timer);
+    }
+}
+
+/* ktimer_run()
+ * Runs every timer on this processor's wheel that expired by its current tick, catching up tick by
+ * tick after a stretch of tickless time. Ticks on which nothing can happen are skipped: with levels
+ * 0 to n-1 empty, nothing changes until the next multiple of 64^n ticks.
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: calls the timers' functions, asks for an interrupt by the next expiry
+ */
+void ktimer_run(void){
+    cpu_t* cpu = this_cpu();
+    ktimer_wheel_t* wheel = &cpu->timers;
+    ktimer_t* timer;
+    uint32_t step;
+    int level, index;
+
+    while((int32_t)(cpu->ticks - wheel->clock) >= 0){
+        index = wheel->clock & WHEEL_MASK;
+
+        // slot 0 coming up means a slot one level up is due, and maybe one above that
+        if(index == 0){
+            for(level = 1; level < WHEEL_LEVELS && wheel_cascade(wheel, level) == 0; level++);
+        }
+
+        while((timer = wheel->slots[0][index]) != NULL){
+            wheel_unlink(timer);
+            timer->fn(timer);
+        }
+
+        for(level = 0; level < WHEEL_LEVELS && wheel->level_count[level] == 0; level++);
+        if(level == WHEEL_LEVELS){
+            wheel->clock = cpu->ticks + 1;
+            break;
+        }
+        step = 1U << (WHEEL_BITS * level);
+        wheel->clock = (wheel->clock + step) & ~(step - 1);
+        if((int32_t)(wheel->clock - cpu->ticks) > 1){
+            wheel->clock = cpu->ticks + 1;
+        }
+    }
+
+    if(wheel->count == 0){
+        return;
+    }
+    if((int32_t)(wheel->next - wheel->clock) < 0){
+        wheel_find_next(wheel);
+    }
+    tick_request(wheel->next);
+}
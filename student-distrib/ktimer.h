@@ -0,0 +1,57 @@
+/* ktimer.h - Kernel timers: callbacks run off the scheduler tick, kept in a hierarchical timing wheel
+ */
+
+#ifndef _KTIMER_H
+#define _KTIMER_H
+
+#include "types.h"
+
+#define WHEEL_BITS          6
+#define WHEEL_SIZE          (1 << WHEEL_BITS)   // slots per level
+#define WHEEL_MASK          (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS        4                   // level n slots are 64^n ticks wide
+#define WHEEL_MAX_TICKS     ((1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1)    // ~2.3 hours of 500us ticks, longer timers are cut to this
+
+struct ktimer;
+
+// called from the timer interrupt with interrupts off - it may re-add its own timer
+typedef void (*ktimer_fn_t)(struct ktimer* timer);
+
+typedef struct ktimer {
+    uint32_t expires;                   // tick it fires at, on the clock of the processor it was armed on
+    ktimer_fn_t fn;
+    void* data;                         // for fn
+    struct ktimer_wheel* wheel;         // wheel it is pending on
+    struct ktimer** slot;               // wheel slot it is linked into, NULL if not pending
+    struct ktimer* next;
+    struct ktimer* prev;
+} ktimer_t;
+
+// every processor has a wheel of its own (cpu_t.timers), run off its own scheduler ticks
+typedef struct ktimer_wheel {
+    ktimer_t* slots[WHEEL_LEVELS][WHEEL_SIZE];
+    uint32_t level_count[WHEEL_LEVELS];         // timers on each level
+    uint32_t count;                             // timers on the whole wheel
+    uint32_t clock;                             // next tick to be processed
+    uint32_t next;                              // no timer fires before this tick (it may be early after a ktimer_del)
+} ktimer_wheel_t;
+
+// empties a wheel, called when a processor starts its scheduler clock
+void ktimer_init_wheel(ktimer_wheel_t* wheel, uint32_t now);
+
+// sets up a timer that isn't pending yet
+void ktimer_setup(ktimer_t* timer, ktimer_fn_t fn, void* data);
+
+// (re)arms a timer on this processor to fire the given number of its ticks from now (at least 1) - call with interrupts off
+void ktimer_add(ktimer_t* timer, uint32_t ticks);
+
+// disarms a timer if it is pending, whichever processor's wheel it is on - call with interrupts off
+void ktimer_del(ktimer_t* timer);
+
+// 1 if the timer is armed and hasn't fired yet
+#define ktimer_pending(timer)   ((timer)->slot != NULL)
+
+// runs every timer on this processor's wheel that expired by its current tick, called from the timer interrupt
+void ktimer_run(void);
+
+#endif /* _KTIMER_H */
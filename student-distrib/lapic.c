@@ -0,0 +1,130 @@
+/* lapic.c - Local APIC access: IPIs, EOI and the APIC timer
+ */
+
+#include "lapic.h"
+#include "lib.h"
+#include "schedule.h"
+
+/* lapic_read / lapic_write
+ * Access a register of this processor's local APIC
+ * Inputs: reg - register offset
+ *         value - what to write
+ * Outputs: register contents (read)
+ * Side Effects: once paging is on, the page at lapic_base has to be mapped (map_lapic)
+ */
+uint32_t lapic_read(uint32_t reg){
+    return *(volatile uint32_t*)(lapic_base + reg);
+}
+
+void lapic_write(uint32_t reg, uint32_t value){
+    *(volatile uint32_t*)(lapic_base + reg) = value;
+    (void)lapic_read(LAPIC_ID);     // wait for the write to finish
+}
+
+/* lapic_present()
+ * Checks CPUID for a local APIC
+ * Inputs: none
+ * Outputs: 1 if there is one, 0 otherwise
+ * Side Effects: sets lapic_base from IA32_APIC_BASE if the MP table didn't give it to us
+ */
+int lapic_present(void){
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t lo, hi;
+
+    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    if(!(edx & CPUID_FEAT_APIC)){
+        return 0;
+    }
+
+    if(lapic_base == 0){
+        asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(IA32_APIC_BASE_MSR));
+        lapic_base = lo & 0xFFFFF000;
+    }
+    return 1;
+}
+
+/* lapic_enable()
+ * Software enables the local APIC. The 8259 keeps delivering through LINT0 as an
+ * external interrupt, so keyboard, RTC and PIT interrupts are unaffected.
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: the timer starts out masked
+ */
+void lapic_enable(void){
+    lapic_write(LAPIC_LVT_LINT0, LVT_EXTINT);
+    lapic_write(LAPIC_LVT_LINT1, LVT_NMI);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+}
+
+/* lapic_ipi(uint8_t apic_id, uint32_t icr)
+ * Sends an inter-processor interrupt and waits until it has been delivered
+ * Inputs: apic_id - local APIC of the target processor
+ *         icr - low half of the interrupt command (type, level, vector)
+ * Outputs: none
+ * Side Effects: none
+ */
+void lapic_ipi(uint8_t apic_id, uint32_t icr){
+    lapic_write(LAPIC_ICR_HI, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_ICR_LO, icr);
+    while(lapic_read(LAPIC_ICR_LO) & ICR_BUSY);
+}
+
+/* lapic_eoi()
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: lets the local APIC deliver the next interrupt of equal or lower priority
+ */
+void lapic_eoi(void){
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/* lapic_timer_calibrate()
+ * The APIC timer runs off the bus clock, whose speed we don't know - count it against
+ * the PIT for LAPIC_CALIBRATE_US
+ * Inputs: none
+ * Outputs: timer counts (at divide by 16) in LAPIC_CALIBRATE_US, 0 if it didn't count
+ * Side Effects: leaves the timer stopped
+ */
+uint32_t lapic_timer_calibrate(void){
+    uint32_t elapsed;
+
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+    lapic_write(LAPIC_TIMER_INIT, LAPIC_TIMER_MAX);
+
+    pit_wait(PIT_FREQ / (1000000 / LAPIC_CALIBRATE_US));
+
+    elapsed = LAPIC_TIMER_MAX - lapic_read(LAPIC_TIMER_CUR);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+    return elapsed;
+}
+
+/* lapic_timer_periodic(uint32_t count)
+ * Inputs: count - timer counts between interrupts
+ * Outputs: none
+ * Side Effects: (re)starts this processor's timer in periodic mode
+ */
+void lapic_timer_periodic(uint32_t count){
+    lapic_write(LAPIC_LVT_TIMER, LVT_PERIODIC | LAPIC_TIMER_VEC);
+    lapic_write(LAPIC_TIMER_INIT, count);
+}
+
+/* lapic_timer_oneshot(uint32_t count)
+ * Inputs: count - timer counts until the interrupt, 0 to stop the timer
+ * Outputs: none
+ * Side Effects: a single MMIO write rearms it - no port I/O like the PIT needs
+ */
+void lapic_timer_oneshot(uint32_t count){
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VEC);
+    lapic_write(LAPIC_TIMER_INIT, count);
+}
+
+/* lapic_timer_current()
+ * Inputs: none
+ * Outputs: counts left until the timer fires, 0 once a one-shot has fired
+ * Side Effects: none
+ */
+uint32_t lapic_timer_current(void){
+    return lapic_read(LAPIC_TIMER_CUR);
+}
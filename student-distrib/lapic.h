@@ -0,0 +1,83 @@
+/* lapic.h - Local APIC access: IPIs, EOI and the APIC timer
+ */
+
+#ifndef _LAPIC_H
+#define _LAPIC_H
+
+#include "types.h"
+
+#define LAPIC_DEFAULT_BASE  0xFEE00000
+#define IA32_APIC_BASE_MSR  0x1B        // bits 31-12 hold the local APIC's physical address
+#define CPUID_FEAT_APIC     0x200       // CPUID leaf 1, EDX bit 9: there is a local APIC
+
+// local APIC registers (offsets from its base)
+#define LAPIC_ID            0x020
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0       // spurious interrupt vector register, bit 8 enables the APIC
+#define LAPIC_ESR           0x280
+#define LAPIC_ICR_LO        0x300
+#define LAPIC_ICR_HI        0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_LVT_LINT0     0x350
+#define LAPIC_LVT_LINT1     0x360
+#define LAPIC_TIMER_INIT    0x380       // initial count, writing it (re)starts the timer, 0 stops it
+#define LAPIC_TIMER_CUR     0x390       // current count
+#define LAPIC_TIMER_DIV     0x3E0
+
+#define LAPIC_SVR_ENABLE    0x100
+#define LAPIC_SPURIOUS_VEC  0xFF
+#define LAPIC_TIMER_VEC     0x40        // above the PIC's 0x20-0x2F
+#define LAPIC_RESCHED_VEC   0x41        // reschedule IPI between processors
+#define LVT_MASKED          0x00010000
+#define LVT_PERIODIC        0x00020000
+#define LVT_EXTINT          0x00000700  // LINT0 passes the 8259's interrupts through (virtual wire mode)
+#define LVT_NMI             0x00000400
+#define LAPIC_TIMER_DIV16   0x3         // timer counts at bus clock / 16
+#define LAPIC_TIMER_MAX     0xFFFFFFFF
+
+#define ICR_FIXED           0x00000000
+#define ICR_INIT            0x00000500
+#define ICR_STARTUP         0x00000600
+#define ICR_LEVEL           0x00008000
+#define ICR_ASSERT          0x00004000
+#define ICR_BUSY            0x00001000  // delivery status - the IPI hasn't been accepted yet
+
+#define LAPIC_CALIBRATE_US  10000       // how long the timer is measured against the PIT
+
+#ifndef ASM
+
+uint32_t lapic_base;            // physical address of the local APICs, 0 if we haven't found one
+
+// register access - every processor sees its own local APIC at lapic_base
+uint32_t lapic_read(uint32_t reg);
+void lapic_write(uint32_t reg, uint32_t value);
+
+// 1 if this processor has a local APIC (lapic_base is filled in from the MSR if the MP table didn't)
+int lapic_present(void);
+
+// software enables this processor's local APIC, keeping the 8259 wired through LINT0
+void lapic_enable(void);
+
+// sends an inter-processor interrupt and waits until it has been delivered
+void lapic_ipi(uint8_t apic_id, uint32_t icr);
+
+// acknowledge the interrupt being serviced
+void lapic_eoi(void);
+
+// timer counts in LAPIC_CALIBRATE_US, measured against PIT channel 2 - 0 if the timer doesn't count
+uint32_t lapic_timer_calibrate(void);
+
+// the timer of the processor calling these - periodic every count, or once after count (0 stops it)
+void lapic_timer_periodic(uint32_t count);
+void lapic_timer_oneshot(uint32_t count);
+uint32_t lapic_timer_current(void);
+
+// timer interrupt (schedule.c) and the assembly linkage for the APIC's vectors - the reschedule IPI's handler is in schedule.h
+void lapic_timer_handler(void);
+extern void LAPIC_TIMER_INTERRUPT(void);
+extern void RESCHED_INTERRUPT(void);
+extern void SPURIOUS_INTERRUPT(void);
+
+#endif /* ASM */
+
+#endif /* _LAPIC_H */
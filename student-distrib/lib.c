@@ -174,6 +174,19 @@ int32_t puts(int8_t* s) {
  * Return Value: void
  *  Function: Output a character to the console */
 void putc(uint8_t c, int term_id) {
+    putc_nocursor(c, term_id);
+
+    // update cursor function ...
+    update_cursor(terminals[curr_term].term_x, terminals[curr_term].term_y);
+}
+
+/* void putc_nocursor(uint8_t c, int term_id);
+ * Inputs: uint_8* c = character to print
+ *         term_id = terminal to print it on
+ * Return Value: void
+ *  Function: Output a character to the console, leaving the cursor where it was - the caller moves it once
+ *            it is done, which saves the four port writes per character */
+void putc_nocursor(uint8_t c, int term_id) {
     if(c == '\0'){
         return;
     }
@@ -212,9 +225,6 @@ void putc(uint8_t c, int term_id) {
         terminals[term_id].term_y = NUM_ROWS-1;      // we do not want to be directly at bottom, but one row up
         terminals[term_id].term_x = 0;
     }
-
-    // update cursor function ...
-    update_cursor(terminals[curr_term].term_x, terminals[curr_term].term_y);
 }
 
 /* int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
@@ -10,6 +10,7 @@
 int32_t printf(int8_t *format, ...);
 // void putc(uint8_t c);
 void putc(uint8_t c, int term_id);
+void putc_nocursor(uint8_t c, int term_id);    // putc without moving the cursor, for writes that move it once at the end
 
 int32_t puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
@@ -34,9 +35,15 @@ void backspace(void);               // for erasing most recent char
 void vert_scroll(int term_id);
 
 /* Userspace address-check functions */
-int32_t bad_userspace_addr(const void* addr, int32_t len);
+int32_t bad_userspace_addr(const void* addr, int32_t len, int write);
 int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
 
+/* One buffer of a vectored read or write (readv/writev) */
+typedef struct iovec {
+    void* base;
+    int32_t len;
+} iovec_t;
+
 // static int screen_x;
 // static int screen_y;
 // static char* video_mem;
@@ -44,6 +51,31 @@ int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
 int screen_x;
 int screen_y;
 
+/* Reads the CPU's time-stamp counter (cycles since reset) */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc"
+            : "=a"(lo), "=d"(hi)
+    );
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Divides *n by base in place and returns the remainder - there is no libgcc for 64 bit division,
+ * so this does it as two 32 bit divl's like long division */
+static inline uint32_t div64_32(uint64_t* n, uint32_t base) {
+    uint32_t hi = (uint32_t)(*n >> 32);
+    uint32_t lo = (uint32_t)*n;
+    uint32_t q_hi = hi / base;
+    uint32_t rem = hi % base;
+    uint32_t q_lo;
+    asm ("divl %2"
+            : "=a"(q_lo), "=d"(rem)
+            : "rm"(base), "0"(lo), "1"(rem)
+    );
+    *n = ((uint64_t)q_hi << 32) | q_lo;
+    return rem;
+}
+
 /* Port read functions */
 /* Inb reads a byte and returns its value as a zero-extended 32-bit
  * unsigned int */
@@ -169,4 +201,37 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Spinlock for data other processors touch too - cli only keeps out this
+ * processor's interrupts. Take it with interrupts off, or an interrupt
+ * handler that wants it as well spins forever */
+typedef struct spinlock {
+    volatile uint32_t locked;
+} spinlock_t;
+
+/* Spins until the lock is free and takes it. xchg is atomic across
+ * processors; while somebody holds it, only read it (pause tells the
+ * processor this is a spin loop) so the cache line isn't bounced around */
+static inline void spin_lock(spinlock_t* lock) {
+    uint32_t held;
+
+    do {
+        while (lock->locked) {
+            asm volatile ("pause");
+        }
+        held = 1;
+        asm volatile ("xchgl %0, %1"
+                : "+r"(held), "+m"(lock->locked)
+                :
+                : "memory"
+        );
+    } while (held);
+}
+
+/* Releases the lock - a plain store is enough on x86, the compiler just
+ * mustn't move accesses to the data it protects past it */
+static inline void spin_unlock(spinlock_t* lock) {
+    asm volatile ("" : : : "memory");
+    lock->locked = 0;
+}
+
 #endif /* _LIB_H */
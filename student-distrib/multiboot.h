@@ -10,6 +10,14 @@
 #define MULTIBOOT_HEADER_MAGIC          0x1BADB002
 #define MULTIBOOT_BOOTLOADER_MAGIC      0x2BADB002
 
+/* multiboot_info_t flags bits */
+#define MULTIBOOT_INFO_MEM              0x00000001  /* mem_lower/mem_upper are valid */
+#define MULTIBOOT_INFO_MODS             0x00000008  /* mods_count/mods_addr are valid */
+#define MULTIBOOT_INFO_MMAP             0x00000040  /* mmap_length/mmap_addr are valid */
+
+/* memory_map_t type of usable RAM */
+#define MULTIBOOT_MMAP_RAM              1
+
 #ifndef ASM
 
 /* Types */
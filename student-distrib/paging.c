@@ -1,11 +1,47 @@
 /* paging.S - set up page directory, page table, and pages */
 
 #include "paging.h"
-// #include "lib.h"
+#include "clock.h"
+#include "frame.h"
+#include "lib.h"
+#include "smp.h"
 // #include "terminal.h"
 
 int32_t video_pages[3] = {TERM_1_VIDPAGE, TERM_2_VIDPAGE, TERM_3_VIDPAGE};
 
+// the application processors' page directories and 132MB page tables - page_directory and vidmap_page_table are the boot processor's
+static pde_t ap_page_directories[SMP_MAX_CPUS - 1][NUM_ENTRIES] __attribute__((aligned (PAGING_ALIGNMENT)));
+static pte_t ap_vidmap_tables[SMP_MAX_CPUS - 1][NUM_ENTRIES] __attribute__((aligned (PAGING_ALIGNMENT)));
+
+/* void load_page_directory(pde_t* dir) - turns paging on with the given page directory
+ * Inputs   : dir - page directory, 4kB aligned
+ * Outputs  : none
+ * Side Effects : only for the processor calling it
+ */
+static void load_page_directory(pde_t* dir) {
+    asm volatile(
+        // load page dir address into CR3 
+        "movl %0, %%eax;"
+        "movl %%eax, %%cr3;"
+
+        // allow mixed page sizes: set PSE, bit 4 in CR4, and honor the global bit: set PGE, bit 7
+        "movl %%cr4, %%eax;"
+        "orl $0x00000090, %%eax;"
+        "movl %%eax, %%cr4;"
+
+        // set bit-31 of CR0 to enable paging, and bit-16 (WP) so the kernel can't write to read-only user pages either -
+        // those can be the filesystem image itself
+        "movl %%cr0, %%eax;"
+        "orl $0x80010001, %%eax;"
+        "movl %%eax, %%cr0"
+
+        
+        :
+        : "r" (dir) 
+        : "eax", "cc"
+    );
+}
+
 /* void init_paging(void) - initializes the page table and page directory
  * Inputs   : none
  * Outputs  : none
@@ -43,6 +79,7 @@ void init_paging(void) {
     }
 
     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].P = 1;
+    page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].G = 1; // the same in every process, so it survives CR3 reloads
     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].U = 0; // vid mem should be set to supervisor only since it is kernel mapping
     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].C = 0; // vid mem contains memory mapped I/O and shouldn't be cached
     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].offset31_12 = VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB; // vid mem contains memory mapped I/O and shouldn't be cached
@@ -58,29 +95,46 @@ void init_paging(void) {
     page_directory[1].offset31_12 = 1024; 
     page_directory[1].P = 1;        // mark as present
     page_directory[1].U = 0;        // kernel stuff should be supervisor only
+    page_directory[1].G = 1;        // global: the kernel's translations survive the CR3 reloads of context switches
+
+    /* 8MB - 128MB is identity mapped for the kernel, so it can reach any page frame the frame allocator hands out */
+    for (i = FRAME_BASE >> ADDRESS_SHIFT_MB; i < FRAME_LIMIT >> ADDRESS_SHIFT_MB; i++) {
+        page_directory[i].P = 1;
+        page_directory[i].U = 0;    // supervisor only, programs see their frames through their own page tables
+        page_directory[i].D = 0;    // cached, like the user mappings of the same frames
+        page_directory[i].G = 1;
+        page_directory[i].offset31_12 = i * FOUR_MB_OFFSET;
+    }
 
     flush_tlb();
 
-    asm volatile(
-        // load page dir address into CR3 
-        "movl %0, %%eax;"
-        "movl %%eax, %%cr3;"
+    cpus[0].page_dir = page_directory;
+    cpus[0].vidmap_pt = vidmap_page_table;
+    load_page_directory(page_directory);
+}
 
-        // allow mixed page sizes: set PSE, bit 4 in CR4
-        "movl %%cr4, %%eax;"
-        "orl $0x00000010, %%eax;"
-        "movl %%eax, %%cr4;"
+/* void init_paging_ap(int idx) - gives an application processor a page directory of its own and turns paging on
+ * Inputs   : idx - index into cpus[] of the processor calling it
+ * Outputs  : none
+ * Side Effects : the kernel half is copied from the boot processor's, which has to be complete by now (the APIC and
+ *                the time page are mapped) - 0MB - 4MB is the same page table. 128MB - 140MB is whatever task runs on it
+ */
+void init_paging_ap(int idx) {
+    pde_t* dir = ap_page_directories[idx - 1];
+    pte_t* vidmap = ap_vidmap_tables[idx - 1];
 
-        // set bit-31 of CR0 to enable paging
-        "movl %%cr0, %%eax;"
-        "orl $0x80000001, %%eax;"
-        "movl %%eax, %%cr0"
+    memcpy(dir, page_directory, sizeof(ap_page_directories[0]));
+    memcpy(vidmap, vidmap_page_table, sizeof(ap_vidmap_tables[0]));
 
-        
-        :
-        : "r" (page_directory) 
-        : "eax", "cc"
-    );
+    // none of the boot processor's program, the time page through its own copy of the table, and scheduling_vidmap fills in the rest
+    dir[USER_PDE].P = 0;
+    dir[MMAP_PDE].P = 0;
+    dir[33].offset31_12 = (uint32_t)vidmap >> ADDRESS_SHIFT_KB;
+    vidmap[0].P = 0;
+
+    cpus[idx].page_dir = dir;
+    cpus[idx].vidmap_pt = vidmap;
+    load_page_directory(dir);
 }
 
 /* void flush_tlb() - TLB needs to be flushed when CR3 reloaded
@@ -88,6 +142,7 @@ void init_paging(void) {
  * Outputs: none
  * Clobbers : memory (since we performed memory reads or writes to items other than those listed in the input and output operands)
  *          : cc (modified flag registers)
+ * Side Effects : drops every non-global entry - the kernel's global ones stay, so changing a global entry needs flush_tlb_page
  */
 void flush_tlb(void) {
     asm volatile(
@@ -97,35 +152,282 @@ void flush_tlb(void) {
         : 
         : "eax"     // clobbered
     );
+    tlb_full_flushes++;
     return;
 }
 
+/* void flush_tlb_page(uint32_t vaddr) - drops the TLB entry of a single page, global or not
+ * Inputs : vaddr - any address in the page
+ * Outputs: none
+ * Side Effects : also drops the cached page directory entry for it, so it does for a changed PDE of a page table
+ *                as long as every page the old table mapped is flushed
+ */
+void flush_tlb_page(uint32_t vaddr) {
+    asm volatile("invlpg (%0)" : : "r"(vaddr) : "memory");
+    tlb_page_flushes++;
+}
+
+/* int set_user_pde(int idx, pte_t* table) - points one of the per process 4MB regions at the process' page table for it
+ * Inputs   : idx - USER_PDE or MMAP_PDE
+ *            table - the page table, NULL if the process has none (the region is then not present)
+ * Outputs  : 1 if the entry changed and the TLB needs a flush, 0 if it was already like that
+ * Side Effects : none
+ */
+static int set_user_pde(int idx, pte_t* table) {
+    pde_t* dir = this_cpu()->page_dir;
+    uint32_t table_offset = (uint32_t)table >> ADDRESS_SHIFT_KB;
+
+    if(table == NULL){
+        if(!dir[idx].P){
+            return 0;
+        }
+        dir[idx].P = 0;
+        return 1;
+    }
+
+    // already mapped (switching between tasks of the same pid, or back to the only one) - keep the TLB
+    if(dir[idx].P && dir[idx].U && dir[idx].R && !dir[idx].S &&
+       dir[idx].offset31_12 == table_offset){
+        return 0;
+    }
+
+    dir[idx].P = 1;   // mark as present
+    // must be user level access -> but might already be set
+    dir[idx].U = 1;   // accessible by all
+    // R/W accessible (each page table entry decides for itself)
+    dir[idx].R = 1;
+    dir[idx].S = 0;
+    dir[idx].D = 0;
+    dir[idx].offset31_12 = table_offset;
+    return 1;
+}
+
 /* void map_user_program()
  * 
- * Inputs   : pid
+ * Inputs   : table - the process' page table (pcb->user_page_table)
+ *            mmap_table - the page table of its mmap region (pcb->mmap_page_table), NULL if it never called mmap
  * Outputs  : none
- * Side Effects : maps the user program from 128MB - 132MB in virtual memory to either 8MB-12MB, 12MB-16MB, etc. in physical memory
- *                if pid == 0, then map to 8-12MB; if pid == 1, then map to 12-16MB, etc.
+ * Side Effects : points 128MB - 132MB in virtual memory at the process' own page table, whose entries map
+ *                the 4kB frames its program and stack were loaded into, and 136MB - 140MB at its mapped files
  * 
  */
-void map_user_program(int pid) {
+void map_user_program(pte_t* table, pte_t* mmap_table) {
     /* mapping */
     // index 32 because user program starts at 128MB in virtual memory and each "index" chunk is 4MB. 128MB/4MB => 32
-    page_directory[32].P = 1;   // mark as present
-    // must be user level access -> but might already be set
-    page_directory[32].U = 1;   // accessible by all
-    // R/W accessible
-    page_directory[32].R = 1;
-    page_directory[32].S = 1;
-    // might need to set more bits?
-    page_directory[32].offset31_12 = (pid + 2) * FOUR_MB_OFFSET;    // we add 2 because the first 0-8MB are taken up already
+    int changed = set_user_pde(USER_PDE, table);
+    changed |= set_user_pde(MMAP_PDE, mmap_table);
 
     /* flush the tlb */
+    if(changed){
+        flush_tlb();
+    }
+}
+
+/* void unmap_user_program() - removes the running program's mapping before its page table is freed
+ * Inputs   : none
+ * Outputs  : none
+ * Side Effects : no stale TLB entry is left pointing at frames that are about to be reused. Other processors the program
+ *                ran on may still point at its tables too - they lose the entries, or set_user_pde would keep them (and
+ *                their TLB) for a new program whose table ends up on the same frame
+ */
+void unmap_user_program(void) {
+    pde_t* dir = this_cpu()->page_dir;
+    pde_t* other;
+    int i, j;
+    int pdes[2] = {USER_PDE, MMAP_PDE};
+
+    for (i = 0; i < num_cpus; i++) {
+        other = cpus[i].page_dir;
+        if (other == NULL || other == dir) {
+            continue;
+        }
+        for (j = 0; j < 2; j++) {
+            if (dir[pdes[j]].P && other[pdes[j]].P && other[pdes[j]].offset31_12 == dir[pdes[j]].offset31_12) {
+                other[pdes[j]].P = 0;
+            }
+        }
+    }
+
+    dir[USER_PDE].P = 0;
+    dir[MMAP_PDE].P = 0;
     flush_tlb();
 }
 
+/* pte_t* user_pt_create() - allocates an empty page table for a program's 128MB - 132MB
+ * Inputs   : none
+ * Outputs  : the table, NULL if there is no free frame
+ * Side Effects : none
+ */
+pte_t* user_pt_create(void) {
+    pte_t* table = (pte_t*)frame_alloc(0);
+
+    if (table != NULL) {
+        memset(table, 0, FOUR_KB);
+    }
+    return table;
+}
+
+/* int32_t user_map_page(pte_t* table, uint32_t vaddr, int writable) - backs one user page with a zeroed frame
+ * Inputs   : table - page table from user_pt_create
+ *            vaddr - any address in the page, between 128MB and 132MB
+ *            writable - 1 if the program may write to it
+ * Outputs  : 0 on success, -1 if there is no free frame
+ * Side Effects : a page that is already mapped keeps its frame, it just becomes writable if asked to
+ *                (two segments can share a page)
+ */
+int32_t user_map_page(pte_t* table, uint32_t vaddr, int writable) {
+    pte_t* entry = &table[(vaddr >> ADDRESS_SHIFT_KB) & (NUM_ENTRIES - 1)];
+    uint32_t frame;
+
+    if (!entry->P) {
+        frame = frame_alloc(0);
+        if (frame == 0) {
+            return -1;
+        }
+        memset((void*)frame, 0, FOUR_KB);
+
+        entry->P = 1;
+        entry->U = 1;
+        entry->C = 0;       // cached
+        entry->offset11_9 &= ~PTE_LAZY;
+        entry->offset31_12 = frame >> ADDRESS_SHIFT_KB;
+    }
+    entry->R |= (writable != 0);
+    return 0;
+}
+
+/* void user_reserve_page(pte_t* table, uint32_t vaddr, int writable) - gives a program a user page without a frame yet
+ * Inputs   : table - page table from user_pt_create
+ *            vaddr - any address in the page, between 128MB and 132MB
+ *            writable - 1 if the program may write to it
+ * Outputs  : none
+ * Side Effects : the entry stays not present - the first access faults and the page fault handler backs it with a frame
+ */
+void user_reserve_page(pte_t* table, uint32_t vaddr, int writable) {
+    pte_t* entry = &table[(vaddr >> ADDRESS_SHIFT_KB) & (NUM_ENTRIES - 1)];
+
+    if (!entry->P) {
+        entry->offset11_9 |= PTE_LAZY;
+    }
+    entry->R |= (writable != 0);
+}
+
+/* void user_map_shared(pte_t* table, uint32_t vaddr, uint32_t frame) - maps a read-only user page onto a frame the program doesn't own
+ * Inputs   : table - page table from user_pt_create
+ *            vaddr - any address in the page, between 128MB and 132MB
+ *            frame - 4kB aligned physical address, a data block of the filesystem image
+ * Outputs  : none
+ * Side Effects : every program running the same file shares the frame, user_pt_destroy leaves it alone
+ */
+void user_map_shared(pte_t* table, uint32_t vaddr, uint32_t frame) {
+    pte_t* entry = &table[(vaddr >> ADDRESS_SHIFT_KB) & (NUM_ENTRIES - 1)];
+
+    entry->P = 1;
+    entry->U = 1;
+    entry->R = 0;
+    entry->C = 0;       // cached
+    entry->offset11_9 = (entry->offset11_9 & ~PTE_LAZY) | PTE_SHARED;
+    entry->offset31_12 = frame >> ADDRESS_SHIFT_KB;
+}
+
+/* void user_pt_destroy(pte_t* table) - frees a program's frames and then its page table
+ * Inputs   : table - page table from user_pt_create, must not be mapped anymore
+ * Outputs  : none
+ * Side Effects : none
+ */
+void user_pt_destroy(pte_t* table) {
+    int i;
+
+    if (table == NULL) {
+        return;
+    }
+    for (i = 0; i < NUM_ENTRIES; i++) {
+        if (table[i].P && !(table[i].offset11_9 & PTE_SHARED)) {
+            frame_free(table[i].offset31_12 << ADDRESS_SHIFT_KB, 0);
+        }
+    }
+    frame_free((uint32_t)table, 0);
+}
+
+/* int32_t bad_userspace_addr(const void* addr, int32_t len, int write) - checks a buffer a program handed to a system call
+ * Inputs   : addr, len - the buffer
+ *            write - 1 if the kernel is going to write to it
+ * Outputs  : 1 if part of it is outside 128MB - 132MB, on a page the running program doesn't have, or on a read-only
+ *            page it is to be written to, 0 if it is fine
+ * Side Effects : none - pages that aren't filled in yet count as the program's, the kernel faults them in when it touches them
+ */
+int32_t bad_userspace_addr(const void* addr, int32_t len, int write) {
+    pde_t* dir = this_cpu()->page_dir;
+    uint32_t start = (uint32_t)addr;
+    uint32_t page;
+    pte_t* table;
+    pte_t* entry;
+
+    if (len < 0 || start < USER_BASE || start > USER_STACK_TOP || (uint32_t)len > USER_STACK_TOP - start) {
+        return 1;
+    }
+    if (!dir[USER_PDE].P || dir[USER_PDE].S) {
+        return 1;
+    }
+
+    table = (pte_t*)(dir[USER_PDE].offset31_12 << ADDRESS_SHIFT_KB);
+    for (page = start & ~(FOUR_KB - 1); page < start + len; page += FOUR_KB) {
+        entry = &table[(page >> ADDRESS_SHIFT_KB) & (NUM_ENTRIES - 1)];
+        if (!entry->P && !(entry->offset11_9 & PTE_LAZY)) {
+            return 1;
+        }
+        if (write && !entry->R) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* void map_lapic(uint32_t lapic_addr) - identity maps the 4MB page holding the local APIC registers
+ * Inputs   : lapic_addr - physical address of the local APIC
+ * Outputs  : none
+ * Side Effects : supervisor only and uncached, since the registers are memory mapped I/O
+ */
+void map_lapic(uint32_t lapic_addr) {
+    uint32_t idx = lapic_addr >> ADDRESS_SHIFT_MB;
+
+    page_directory[idx].P = 1;
+    page_directory[idx].U = 0;
+    page_directory[idx].R = 1;
+    page_directory[idx].S = 1;
+    page_directory[idx].D = 1;      // cache disabled
+    page_directory[idx].W = 1;
+    page_directory[idx].G = 1;
+    page_directory[idx].offset31_12 = idx * FOUR_MB_OFFSET;
+
+    flush_tlb_page(lapic_addr);
+}
+
+/* void map_time_page(uint32_t page_addr) - maps the clock's time page read-only for user programs, next to the vidmap page
+ * Inputs   : uint32_t page_addr - physical address of the 4kB time page
+ * Outputs  : none
+ * Side Effects : makes the 132MB page table present, the vidmap entry in it stays as it is
+ */
+void map_time_page(uint32_t page_addr) {
+    page_directory[33].P = 1;
+    page_directory[33].U = 1;
+    page_directory[33].R = 1;   // the vidmap page is writable, the time page entry itself isn't
+    page_directory[33].S = 0;
+    page_directory[33].offset31_12 = (uint32_t)vidmap_page_table >> ADDRESS_SHIFT_KB;
+
+    vidmap_page_table[TIME_PAGE_ENTRY].P = 1;
+    vidmap_page_table[TIME_PAGE_ENTRY].U = 1;
+    vidmap_page_table[TIME_PAGE_ENTRY].R = 0;
+    vidmap_page_table[TIME_PAGE_ENTRY].offset31_12 = page_addr >> ADDRESS_SHIFT_KB;
+
+    flush_tlb_page(TIME_PAGE_ADDR);
+}
+
 /* void map_vidmem() - maps a new 4kB chunk in virtual memory to the original 4kB video memory page in physical address */
 void map_vidmem() {
+    pde_t* page_directory = this_cpu()->page_dir;
+    pte_t* vidmap_page_table = this_cpu()->vidmap_pt;
+
     // index 33 because we need to place somewhere after user-level process memory (132MB+)
     page_directory[33].P = 1;   // mark as present
     // must be user level access -> but might already be set
@@ -140,7 +442,7 @@ void map_vidmem() {
     vidmap_page_table[0].R = 1;
     vidmap_page_table[0].offset31_12 = (VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB);
 
-    flush_tlb();
+    flush_tlb_page(VIDMAP_PAGE_ADDR);
 }
 
 /* void scheduling_vidmap(int terminal) - maps VM's video memory (0xB8000) to one of the background buffers in physical memory
@@ -149,57 +451,56 @@ void map_vidmem() {
  * Side Effects : none
  */ 
 void scheduling_vidmap(int terminal, int curr_term) {
+    pde_t* page_directory = this_cpu()->page_dir;
+    pte_t* vidmap_page_table = this_cpu()->vidmap_pt;
+    uint32_t vid_offset;
+    uint32_t page_idx;
 
-    // map_vidmem();
-    page_directory[33].P = 1;   // mark as present
-    // must be user level access -> but might already be set
-    page_directory[33].U = 1;   // accessible by all
-    // R/W accessible
-    page_directory[33].R = 1;
-    page_directory[33].S = 0; 
-    page_directory[33].offset31_12 = (uint32_t)vidmap_page_table >> ADDRESS_SHIFT_KB;
-
+    // user vidmap page: real video memory for the terminal on screen, its backup buffer otherwise
     if(terminal != curr_term){
-        vidmap_page_table[0].P = 1;
-        vidmap_page_table[0].U = 1;
-        vidmap_page_table[0].R = 1;
-        vidmap_page_table[0].offset31_12 = (VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB) + (terminal + 1);
+        vid_offset = (VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB) + (terminal + 1);
+        page_idx = video_pages[terminal] >> ADDRESS_SHIFT_KB;
     }
     else{
+        vid_offset = (VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB);
+        page_idx = VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB;
+    }
+
+    // only entries that actually change need their TLB entry flushed - most switches stay on the same terminal layout
+    if(!page_directory[33].P || !page_directory[33].U || !page_directory[33].R || page_directory[33].S ||
+       page_directory[33].offset31_12 != (uint32_t)vidmap_page_table >> ADDRESS_SHIFT_KB){
+        // map_vidmem();
+        page_directory[33].P = 1;   // mark as present
+        // must be user level access -> but might already be set
+        page_directory[33].U = 1;   // accessible by all
+        // R/W accessible
+        page_directory[33].R = 1;
+        page_directory[33].S = 0; 
+        page_directory[33].offset31_12 = (uint32_t)vidmap_page_table >> ADDRESS_SHIFT_KB;
+        // both pages of the table
+        flush_tlb_page(VIDMAP_PAGE_ADDR);
+        flush_tlb_page(TIME_PAGE_ADDR);
+    }
+
+    if(!vidmap_page_table[0].P || !vidmap_page_table[0].U || !vidmap_page_table[0].R ||
+       vidmap_page_table[0].offset31_12 != vid_offset){
         vidmap_page_table[0].P = 1;
         vidmap_page_table[0].U = 1;
         vidmap_page_table[0].R = 1;
-        vidmap_page_table[0].offset31_12 = (VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB);
+        vidmap_page_table[0].offset31_12 = vid_offset;
+        flush_tlb_page(VIDMAP_PAGE_ADDR);
     }
 
-    if(terminal != curr_term){
-        page_table[video_pages[terminal] >> ADDRESS_SHIFT_KB].P = 1;
-        page_table[video_pages[terminal] >> ADDRESS_SHIFT_KB].U = 1;
-        page_table[video_pages[terminal] >> ADDRESS_SHIFT_KB].R = 1;
-        page_table[video_pages[terminal] >> ADDRESS_SHIFT_KB].offset31_12 = (video_pages[terminal] >> ADDRESS_SHIFT_KB);
-        // page_table[video_pages[terminal] >> ADDRESS_SHIFT_KB].offset31_12 = (VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB) + (terminal + 1);
+    // kernel side: the page the task's terminal output goes to is identity mapped
+    if(!page_table[page_idx].P || !page_table[page_idx].U || !page_table[page_idx].R || !page_table[page_idx].G ||
+       page_table[page_idx].offset31_12 != page_idx){
+        page_table[page_idx].P = 1;
+        page_table[page_idx].U = 1;
+        page_table[page_idx].R = 1;
+        page_table[page_idx].G = 1;
+        page_table[page_idx].offset31_12 = page_idx;
+        flush_tlb_page(page_idx << ADDRESS_SHIFT_KB);
     }
-    else{
-        page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].P = 1;
-        page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].U = 1;
-        page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].R = 1;
-        page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].offset31_12 = (VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB);
-    }
-
-    // if(terminal != curr_term){
-    //     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].P = 1;
-    //     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].U = 1;
-    //     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].R = 1;
-    //     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].offset31_12 = (VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB) + (terminal + 1);
-    // }
-    // else{
-    //     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].P = 1;
-    //     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].U = 1;
-    //     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].R = 1;
-    //     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].offset31_12 = (VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB);
-    // }
-
-    flush_tlb();
 }
 
 // **NEW**
@@ -209,7 +510,8 @@ void vidmap_term(int term_id) {
     page_table[(VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB)+term_id+1].P = 1;
     page_table[(VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB)+term_id+1].U = 1;
     page_table[(VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB)+term_id+1].R = 1;
+    page_table[(VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB)+term_id+1].G = 1;     // kernel's view of the backup buffer, the same in every process
     page_table[(VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB)+term_id+1].offset31_12 = (VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB) + (term_id + 1);
 
-    flush_tlb();
+    flush_tlb_page(VIDMEM_ADDRESS + (term_id + 1) * FOUR_KB);
 }
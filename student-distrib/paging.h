@@ -1,6 +1,9 @@
 /* paging.h - Defines for various paging stuff: paging directory, paging table, etc.
  */
 
+#ifndef _PAGING_H
+#define _PAGING_H
+
 #include "x86_desc.h"   // most likely???
 
 /* macros */
@@ -16,6 +19,21 @@
 #define FOUR_KB             0x1000
 #define FOUR_MB             0x400000
 
+#define USER_PDE            32          // 128MB - 132MB: the running program, through its own page table
+#define USER_BASE           0x08000000
+#define PROGRAM_IMAGE_ADDR  0x08048000  // where ELF programs are linked to start
+#define USER_STACK_TOP      0x08400000  // user stack grows down from 132MB
+#define USER_STACK_PAGES    4           // 16kB of stack, more than the largest local arrays in the programs
+
+#define VIDMAP_PAGE_ADDR    0x08400000  // 132MB: the user mapping of video memory, entry 0 of vidmap_page_table
+
+#define MMAP_PDE            34          // 136MB - 140MB: files the program mapped with mmap, through a page table of its own
+#define MMAP_BASE           0x08800000
+#define MMAP_LIMIT          0x08C00000
+
+#define PTE_LAZY            0x1         // offset11_9 of a user pte that isn't present yet: the page fault handler fills it in
+#define PTE_SHARED          0x2         // offset11_9 of a user pte whose frame is a block of the filesystem image, not the program's
+
 #define TERM_1_VIDPAGE 0x000B9000
 #define TERM_2_VIDPAGE 0x000BA000
 #define TERM_3_VIDPAGE 0x000BB000
@@ -34,7 +52,7 @@ typedef struct pde {
             uint32_t A              : 1;    // accessed bit
             uint32_t bit6           : 1;    // unused bit
             uint32_t S              : 1;    // Page Size (if set, pages are 4MB, else 4kB)
-            uint32_t G              : 1;    // ignored bit
+            uint32_t G              : 1;    // global flag (4MB pages only, ignored otherwise)
             uint32_t offset11_9     : 3;
             uint32_t offset31_12    : 20;
         } __attribute__ ((packed));
@@ -58,15 +76,31 @@ typedef struct __attribute__((packed)) pte {
 
 /* global variables */
 pte_t page_table[NUM_ENTRIES] __attribute__ ((aligned (PAGING_ALIGNMENT)));     // 0 to 4
-pde_t page_directory[NUM_ENTRIES] __attribute__((aligned (PAGING_ALIGNMENT)));
+pde_t page_directory[NUM_ENTRIES] __attribute__((aligned (PAGING_ALIGNMENT)));             // the boot processor's, see cpu_t in smp.h
 pte_t vidmap_page_table[NUM_ENTRIES] __attribute__ ((aligned (PAGING_ALIGNMENT)));          // 128 to 132
 
+// TLB invalidations since boot: CR3 reloads (which keep the global kernel entries) and single page invlpg's
+uint32_t tlb_full_flushes;
+uint32_t tlb_page_flushes;
+
 /* functions in paging.c */
 void init_paging(void);
+void init_paging_ap(int idx);
 extern void flush_tlb(void);
-void map_user_program(int pid);
+void flush_tlb_page(uint32_t vaddr);
+void map_user_program(pte_t* table, pte_t* mmap_table);
+void unmap_user_program(void);
+pte_t* user_pt_create(void);
+int32_t user_map_page(pte_t* table, uint32_t vaddr, int writable);
+void user_reserve_page(pte_t* table, uint32_t vaddr, int writable);
+void user_map_shared(pte_t* table, uint32_t vaddr, uint32_t frame);
+void user_pt_destroy(pte_t* table);
 void map_vidmem(void);
+void map_lapic(uint32_t lapic_addr);
+void map_time_page(uint32_t page_addr);
 void vidmap_term(int term_id);
 // void scheduling_vidmap(int terminal);
 void scheduling_vidmap(int terminal, int curr_term);
 //void map_vidmem(uint8_t** screen_start, int pid);
+
+#endif /* _PAGING_H */
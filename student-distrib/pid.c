@@ -0,0 +1,168 @@
+/* pid.c - Process ids and kernel stacks: a two level pid bitmap and a pool of 8kB stacks
+ *
+ * Bit b of pid_map[w] is set when pid w * 32 + b is free, and bit w of pid_summary is set when
+ * pid_map[w] has any free pid left, so finding the lowest free pid takes two bsf's.
+ */
+
+#include "pid.h"
+#include "frame.h"
+#include "lib.h"
+
+static uint32_t pid_summary;
+static uint32_t pid_map[PID_WORDS];
+
+static uint32_t kstack_pool;            // freed stacks, linked through their first word
+static int kstack_pool_count;
+static uint32_t kstack_deferred;        // freed while it was still in use, 0 if none
+
+/* bsf(uint32_t word)
+ * Inputs: word - must not be 0
+ * Outputs: index of the lowest set bit
+ */
+static inline uint32_t bsf(uint32_t word){
+    uint32_t idx;
+    asm ("bsfl %1, %0" : "=r"(idx) : "rm"(word) : "cc");
+    return idx;
+}
+
+/* pid_init()
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: every pid is free, the stack pool is empty
+ */
+void pid_init(void){
+    int i;
+
+    for(i = 0; i < PID_WORDS; i++){
+        pid_map[i] = 0xFFFFFFFF;
+    }
+    pid_summary = 0xFFFFFFFF;
+    kstack_pool = 0;
+    kstack_pool_count = 0;
+    kstack_deferred = 0;
+}
+
+/* pid_alloc()
+ * Inputs: none
+ * Outputs: the lowest free pid, -1 if there is none
+ * Side Effects: marks it in use
+ */
+int pid_alloc(void){
+    uint32_t w, b, flags;
+
+    cli_and_save(flags);
+    if(pid_summary == 0){
+        restore_flags(flags);
+        return -1;
+    }
+
+    w = bsf(pid_summary);
+    b = bsf(pid_map[w]);
+    pid_map[w] &= ~(1U << b);
+    if(pid_map[w] == 0){
+        pid_summary &= ~(1U << w);
+    }
+    restore_flags(flags);
+
+    return w * PID_WORD_BITS + b;
+}
+
+/* pid_free(int pid)
+ * Inputs: pid - a pid from pid_alloc
+ * Outputs: none
+ * Side Effects: none
+ */
+void pid_free(int pid){
+    uint32_t flags;
+
+    if(pid < 0 || pid >= PID_LIMIT){
+        return;
+    }
+
+    cli_and_save(flags);
+    pid_map[pid / PID_WORD_BITS] |= 1U << (pid % PID_WORD_BITS);
+    pid_summary |= 1U << (pid / PID_WORD_BITS);
+    restore_flags(flags);
+}
+
+/* kstack_current()
+ * Outputs: the kernel stack we are running on, found the same way get_pcb_ptr finds the pcb
+ */
+static uint32_t kstack_current(void){
+    uint32_t esp;
+    asm volatile ("movl %%esp, %0" : "=r"(esp));
+    return esp & ~(KSTACK_SIZE - 1);
+}
+
+/* kstack_release(uint32_t stack)
+ * Puts a stack nobody runs on back in the pool, or in the frame allocator once the pool is full
+ * Inputs: stack - bottom of the stack
+ * Outputs: none
+ * Side Effects: call with interrupts off
+ */
+static void kstack_release(uint32_t stack){
+    if(kstack_pool_count < KSTACK_POOL_MAX){
+        *(uint32_t*)stack = kstack_pool;
+        kstack_pool = stack;
+        kstack_pool_count++;
+    }
+    else{
+        frame_free(stack, KSTACK_ORDER);
+    }
+}
+
+/* kstack_reap()
+ * Releases the deferred stack once we are off it
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: call with interrupts off
+ */
+static void kstack_reap(void){
+    if(kstack_deferred != 0 && kstack_deferred != kstack_current()){
+        kstack_release(kstack_deferred);
+        kstack_deferred = 0;
+    }
+}
+
+/* kstack_alloc()
+ * Inputs: none
+ * Outputs: bottom of an 8kB aligned kernel stack (where the pcb goes), 0 if out of memory
+ * Side Effects: none
+ */
+uint32_t kstack_alloc(void){
+    uint32_t stack, flags;
+
+    cli_and_save(flags);
+    kstack_reap();
+    if(kstack_pool != 0){
+        stack = kstack_pool;
+        kstack_pool = *(uint32_t*)stack;
+        kstack_pool_count--;
+    }
+    else{
+        stack = frame_alloc(KSTACK_ORDER);
+    }
+    restore_flags(flags);
+
+    return stack;
+}
+
+/* kstack_free(uint32_t stack)
+ * Inputs: stack - bottom of a stack from kstack_alloc
+ * Outputs: none
+ * Side Effects: halt frees the stack it is running on, so that one waits until the next alloc or free
+ */
+void kstack_free(uint32_t stack){
+    uint32_t flags;
+
+    cli_and_save(flags);
+    kstack_reap();
+    if(stack == kstack_current()){
+        // only one can be pending: a second halt can't run on the same stack before we have left it
+        kstack_deferred = stack;
+    }
+    else{
+        kstack_release(stack);
+    }
+    restore_flags(flags);
+}
@@ -0,0 +1,31 @@
+/* pid.h - Process ids and kernel stacks: a two level pid bitmap and a pool of 8kB stacks
+ */
+
+#ifndef _PID_H
+#define _PID_H
+
+#include "types.h"
+
+#define PID_WORD_BITS       32
+#define PID_WORDS           32          // one summary word covers all of them
+#define PID_LIMIT           (PID_WORDS * PID_WORD_BITS)
+#define KSTACK_SIZE         0x2000      // kernel stack of a process, its pcb sits at the bottom
+#define KSTACK_ORDER        1           // 2 frames - buddy blocks are aligned to their size, so PCB_MASK still finds the pcb
+#define KSTACK_POOL_MAX     16          // freed stacks kept around for the next execute
+
+// clears the pid bitmap and the stack pool
+void pid_init(void);
+
+// takes the lowest free pid (so the first three are the terminals' shells), -1 if all are in use
+int pid_alloc(void);
+
+// gives a pid back
+void pid_free(int pid);
+
+// an 8kB aligned kernel stack, 0 if out of memory
+uint32_t kstack_alloc(void);
+
+// gives a kernel stack back - the one we are running on is only reclaimed after we have left it
+void kstack_free(uint32_t stack);
+
+#endif /* _PID_H */
@@ -3,16 +3,20 @@
 #include "i8259.h"
 #include "lib.h"
 #include "rtc.h"
+#include "syscall.h"
 
-volatile int rtc_interrupt_occurred;    // flag for rtc
+static wait_queue_t rtc_wq;             // tasks blocked in rtc_read
+static uint32_t rtc_next_wakeup;        // earliest hardware tick any sleeper is waiting for
+static int rtc_open_count;              // number of open RTC fds - interrupts are masked when 0
 
 /*
  * rtc_init
- *   DESCRIPTION: Initializes rtc for usage 
+ *   DESCRIPTION: Initializes rtc for usage. The hardware is programmed once at its
+ *                maximum rate; each fd divides it down to its own virtual frequency.
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Enables IRQ on pic, outputs data to RTC data port
+ *   SIDE EFFECTS: outputs data to RTC data port, IRQ stays masked until the first rtc_open
  */   
 //frequency =  32768 >> (rate-1);
 void rtc_init(){
@@ -22,14 +26,18 @@ void rtc_init(){
     char b_val = inb(DATA_PORT); //hold the value of regB
     outb(SREG_B, IDX_PORT); //select regB again
     outb(b_val | 0x40, DATA_PORT); //set the 6th bit of reg B to 1 to turn on periodic interrupts 
-    int rate = 0x0F; //initialized at 2hz
+    int rate = RTC_MAX_RATE; //always run at 1024hz
     outb(SREG_A, IDX_PORT);  //select regA
 	char a_val = inb(DATA_PORT); //hold the value of reg A
 	outb(SREG_A, IDX_PORT); //select regA again
 	outb((a_val & 0xF0) | rate, DATA_PORT); //set rate
     outb(SREG_C, IDX_PORT);	// select register C
     inb(DATA_PORT);		//throw away contents
-    enable_irq(8);  //enable irq on pin 8 (first pin on slave)
+
+    rtc_ticks = 0;
+    rtc_open_count = 0;
+    rtc_next_wakeup = 0;
+    wq_init(&rtc_wq);
     
     return;
 }
@@ -37,110 +45,108 @@ void rtc_init(){
 
 /*
  * rtc_open
- *   DESCRIPTION: open rtc set frequency to default 
+ *   DESCRIPTION: open rtc, unmasks the RTC interrupt for the first open fd 
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: 0
- *   SIDE EFFECTS:changes rtc frequency
+ *   SIDE EFFECTS: the fd starts at RTC_DEFAULT_FREQ (set up by sys_open)
  */ 
 int32_t rtc_open(const uint8_t* filename) {
-    set_rtcFrequency(2);
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (rtc_open_count++ == 0) {
+        outb(SREG_C, IDX_PORT);	// drop any interrupt left pending while masked, or the RTC never fires again
+        inb(DATA_PORT);
+        enable_irq(RTC_IRQ);
+    }
+    restore_flags(flags);
     return 0;
 }
 
 
 /*
  * rtc_close
- *   DESCRIPTION: close rtc
+ *   DESCRIPTION: close rtc, masks the RTC interrupt once no fd uses it
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: 0
  *   SIDE EFFECTS: none
  */ 
 int32_t rtc_close(int32_t fd) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (rtc_open_count > 0 && --rtc_open_count == 0)
+        disable_irq(RTC_IRQ);
+    restore_flags(flags);
     return 0;
 }
 
 
 /*
  * rtc_read
- *   DESCRIPTION: read from rtc 
- *   INPUTS: none
+ *   DESCRIPTION: blocks until the next virtual tick of this fd
+ *   INPUTS: fd - RTC file descriptor
  *   OUTPUTS: none
- *   RETURN VALUE: always returns 0 (only after interrupt has occured)
- *   SIDE EFFECTS: waits until interrupt has occured
+ *   RETURN VALUE: always returns 0 (only after the virtual tick has occured)
+ *   SIDE EFFECTS: sleeps on the RTC wait queue, bumps the fd's virtual tick counter
  */ 
 
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes) {
-    rtc_interrupt_occurred = 0;
-    while(!rtc_interrupt_occurred){
+    files_t* file = &(get_pcb_ptr()->fda[fd]);
+    uint32_t interval = RTC_MAX_FREQ / file->rtc_freq;     // hardware ticks per virtual tick
+    uint32_t deadline;
+    uint32_t flags;
+
+    cli_and_save(flags);
+
+    // virtual ticks fall on multiples of the interval, like a real RTC running at that rate
+    deadline = (rtc_ticks / interval + 1) * interval;
+    while ((int32_t)(rtc_ticks - deadline) < 0) {
+        if (rtc_wq.head == NULL || (int32_t)(deadline - rtc_next_wakeup) < 0)
+            rtc_next_wakeup = deadline;
+        wq_sleep(&rtc_wq);
     }
+    file->file_position++;      // for the RTC, file_position counts virtual ticks delivered
+
+    restore_flags(flags);
     return 0;
 }
 
 
 /*
  * rtc_write
- *   DESCRIPTION: writes a frequency to the rtc
- *   INPUTS: none
+ *   DESCRIPTION: sets the virtual frequency of this fd only
+ *   INPUTS: fd - RTC file descriptor
+ *           buf - pointer to the new frequency (int)
  *   OUTPUTS: none
  *   RETURN VALUE: -1 on failure 0 on success 
- *   SIDE EFFECTS: modifies rtc interrupt frequency
+ *   SIDE EFFECTS: other RTC fds are unaffected, the hardware rate never changes
  */ 
 int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
-    if (buf == NULL || set_rtcFrequency(*(int*)(buf)) == -1)
+    if (buf == NULL || !rtc_valid_frequency(*(int*)(buf)))
         return -1;
+    get_pcb_ptr()->fda[fd].rtc_freq = *(int*)(buf);
     return 0;
 }
 
 
 /*
- * set_rtcFrequency
- *   DESCRIPTION: changes the RTC frequency
- *   INPUTS: none
+ * rtc_valid_frequency
+ *   DESCRIPTION: checks whether a frequency can be virtualized
+ *   INPUTS: frequency - requested frequency in Hz
  *   OUTPUTS: none
- *   RETURN VALUE: -1 on failure 0 on success
- *   SIDE EFFECTS: changes the frequency of RTC
+ *   RETURN VALUE: 1 if it is a power of 2 between 2 and 1024, 0 otherwise
+ *   SIDE EFFECTS: none
  */
-int set_rtcFrequency (int frequency) {
-    int rate;
-    // if not within range, return -1
-    if (frequency < 2 || frequency > 1024)
-        return -1;
-
-    // determine frequency by powers of 2
-    // rate starts at 15, decrement for every power of 2
-    if (frequency == 2)
-	    rate = 0x0F;
-	if (frequency == 4)
-		rate = 0x0E;
-	if (frequency == 8)
-		rate = 0x0D;
-	if (frequency == 16)
-		rate = 0x0c;
-	if (frequency == 32)
-		rate = 0x0b;
-	if (frequency == 64)
-		rate = 0x0a;
-	if (frequency == 128)
-		rate = 0x09;
-	if (frequency == 256)
-		rate = 0x08;
-	if (frequency == 512)
-		rate = 0x07;
-	if (frequency == 1024)
-		rate = 0x06;
-
-    cli();
-    
-	outb(SREG_A, IDX_PORT);  //select regA
-	char a_val = inb(DATA_PORT); //hold the value of reg A
-	outb(SREG_A, IDX_PORT); //select regA again
-	outb((a_val & 0xF0) | rate, DATA_PORT); //set rate (high 4 bits are value of reg A, low 4 are the rate)
-
-	sti();
+int rtc_valid_frequency (int frequency) {
+    // if not within range, invalid
+    if (frequency < 2 || frequency > RTC_MAX_FREQ)
+        return 0;
 
-    return 0;
+    // must be a power of 2 so the hardware rate divides evenly
+    return (frequency & (frequency - 1)) == 0;
 }
 
 
@@ -150,16 +156,112 @@ int set_rtcFrequency (int frequency) {
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Enables IRQ on pic, outputs data to RTC data port
+ *   SIDE EFFECTS: counts the tick, wakes rtc_read sleepers once one of them is due
  */   
 void rtc_handler(){
     //disable interrupts
     // cli(); 
     outb(SREG_C, IDX_PORT);	// select register C
     inb(DATA_PORT);		//throw away contents
-    rtc_interrupt_occurred = 1;
+    rtc_ticks++;
+
+    // only wake sleepers when the earliest deadline passes - the rest go back to sleep and re-arm it
+    if (rtc_wq.head != NULL && (int32_t)(rtc_ticks - rtc_next_wakeup) >= 0) {
+        rtc_next_wakeup = rtc_ticks + 0x7FFFFFFF;
+        wq_wake_up(&rtc_wq);
+    }
     //test_interrupts();
     send_eoi(8); //send eoi to RTC, slave pin 1 so 8
     // sti(); //restore
     return;
 }
+
+
+/*
+ * cmos_read
+ *   DESCRIPTION: reads one CMOS register
+ *   INPUTS: reg - register index, with the NMI-disable bit
+ *   OUTPUTS: none
+ *   RETURN VALUE: register contents
+ *   SIDE EFFECTS: none
+ */
+static uint8_t cmos_read(uint8_t reg) {
+    outb(reg, IDX_PORT);
+    return inb(DATA_PORT);
+}
+
+/*
+ * bcd_to_bin
+ *   DESCRIPTION: converts a CMOS register from BCD unless the clock is in binary mode
+ */
+static uint32_t bcd_to_bin(uint8_t val, uint8_t reg_b) {
+    if (reg_b & SREG_B_BINARY)
+        return val;
+    return (val & 0x0F) + (val >> 4) * 10;
+}
+
+/*
+ * rtc_read_wallclock
+ *   DESCRIPTION: reads the date and time from the CMOS clock
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: seconds since 1970-01-01 00:00 (the clock is assumed to be on UTC)
+ *   SIDE EFFECTS: spins up to a second if the clock is in the middle of an update
+ */
+uint32_t rtc_read_wallclock(void) {
+    static const uint16_t month_days[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    uint8_t now[7], last[7];
+    uint8_t reg_b;
+    uint32_t sec, min, hour, day, month, year, century;
+    uint32_t days, y;
+    int i, same;
+
+    // the registers can change between reads, so read them until two passes in a row agree
+    for (i = 0; i < 7; i++)
+        now[i] = 0xFF;          // never a valid BCD or binary value, so the first pass always repeats
+    do {
+        for (i = 0; i < 7; i++)
+            last[i] = now[i];
+        while (cmos_read(SREG_A) & SREG_A_UIP);
+        now[0] = cmos_read(CMOS_SEC);
+        now[1] = cmos_read(CMOS_MIN);
+        now[2] = cmos_read(CMOS_HOUR);
+        now[3] = cmos_read(CMOS_DAY);
+        now[4] = cmos_read(CMOS_MONTH);
+        now[5] = cmos_read(CMOS_YEAR);
+        now[6] = cmos_read(CMOS_CENTURY);
+        same = 1;
+        for (i = 0; i < 7; i++)
+            same &= (now[i] == last[i]);
+    } while (!same);
+
+    reg_b = cmos_read(SREG_B);
+    sec = bcd_to_bin(now[0], reg_b);
+    min = bcd_to_bin(now[1], reg_b);
+    hour = bcd_to_bin(now[2] & ~CMOS_HOUR_PM, reg_b);
+    day = bcd_to_bin(now[3], reg_b);
+    month = bcd_to_bin(now[4], reg_b);
+    year = bcd_to_bin(now[5], reg_b);
+    century = bcd_to_bin(now[6], reg_b);
+
+    // 12 hour mode: 12 AM is hour 0, the PM hours come after it
+    if (!(reg_b & SREG_B_24H)) {
+        hour %= 12;
+        if (now[2] & CMOS_HOUR_PM)
+            hour += 12;
+    }
+
+    // without a century register, assume this century
+    year += (century >= 19 && century <= 99) ? century * 100 : 2000;
+    if (month < 1 || month > 12 || day < 1 || year < 1970)
+        return 0;
+
+    days = 0;
+    for (y = 1970; y < year; y++)
+        days += ((y % 4 == 0 && y % 100 != 0) || y % 400 == 0) ? 366 : 365;
+    days += month_days[month - 1] + day - 1;
+    if (month > 2 && ((year % 4 == 0 && year % 100 != 0) || year % 400 == 0))
+        days++;
+
+    return ((days * 24 + hour) * 60 + min) * 60 + sec;
+}
@@ -9,12 +9,34 @@
 #define SREG_C		    0x8C
 #define IRQ_PORT        0x08
 
+#define RTC_IRQ         8
+#define RTC_MAX_FREQ    1024    // hardware always runs at this rate, every fd gets a virtual rate below it
+#define RTC_MAX_RATE    0x06    // rate divider for 1024 Hz: 32768 >> (rate-1)
+#define RTC_DEFAULT_FREQ 2      // virtual rate of a freshly opened fd
+
+// CMOS clock registers, with bit 7 set to keep NMI disabled like SREG_A/B/C
+#define CMOS_SEC        0x80
+#define CMOS_MIN        0x82
+#define CMOS_HOUR       0x84
+#define CMOS_DAY        0x87
+#define CMOS_MONTH      0x88
+#define CMOS_YEAR       0x89
+#define CMOS_CENTURY    0xB2    // not standard, but QEMU and most PCs have it here
+#define SREG_A_UIP      0x80    // update in progress - the clock registers are changing
+#define SREG_B_24H      0x02
+#define SREG_B_BINARY   0x04    // registers are binary instead of BCD
+#define CMOS_HOUR_PM    0x80    // 12 hour mode only
+
+// hardware RTC ticks since boot (at RTC_MAX_FREQ while any RTC fd is open)
+volatile uint32_t rtc_ticks;
+
 //used to initialize the RTC
 void rtc_init();
 
 //simple handler for rtc checkpoint one test
 extern void rtc_handler();
-int set_rtcFrequency(int frequency);
+int rtc_valid_frequency(int frequency);
+uint32_t rtc_read_wallclock(void);
 int32_t rtc_open(const uint8_t* filename);
 int32_t rtc_close(int32_t fd);
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes);
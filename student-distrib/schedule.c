@@ -1,37 +1,569 @@
-
 #include "schedule.h"
+#include "lapic.h"
+#include "ktimer.h"
+#include "smp.h"
+
+// the calibration - the same on every processor
+static uint32_t tick_period;        // timer counts per scheduler tick
+static uint32_t timer_max_count;    // longest one-shot the timer can do
+
+// kernel stacks for the idle tasks, 8kB aligned like the process stacks so the pcb sits at the bottom
+static uint8_t idle_stacks[SMP_MAX_CPUS][EIGHT_KB] __attribute__((aligned(EIGHT_KB)));
+
+static const uint32_t mlfq_quanta_us[MLFQ_LEVELS] = MLFQ_QUANTA_US;
+static int mlfq_quanta[MLFQ_LEVELS];    // the same in ticks of whichever timer we ended up with
+static uint32_t mlfq_boost_ticks;
+
+// the unlocked run queue primitives, further down with the rest of the run queue code
+static void rq_link(run_queue_t* rq, pcb_t* task);
+static void rq_unlink(run_queue_t* rq, pcb_t* task);
+
+/* init_timer()
+ * Picks the scheduler clock: the local APIC timer if there is one and it calibrates, the PIT otherwise.
+ * The APIC timer ticks every TICK_US_LAPIC and is rearmed with a single register write; the PIT stays
+ * at TICK_US_PIT because every reprogram costs several port writes.
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: starts the boot processor's clock, enables the timer interrupt and interrupts in general
+ */
+void init_timer(void){
+    uint32_t calibrated;
+    int i;
+
+    cli();
+    timer_lapic = 0;
+    if(lapic_present()){
+        map_lapic(lapic_base);
+        lapic_enable();
+        calibrated = lapic_timer_calibrate();
+
+        // every processor's timer runs off the same bus clock, so this calibration does for all of them
+        if(calibrated >= LAPIC_CALIBRATE_US / TICK_US_LAPIC){
+            timer_lapic = 1;
+            tick_us = TICK_US_LAPIC;
+            tick_period = calibrated / (LAPIC_CALIBRATE_US / TICK_US_LAPIC);
+            timer_max_count = LAPIC_TIMER_MAX;
+        }
+    }
+
+    if(timer_lapic){
+        // the PIT's channel 0 isn't needed anymore - stop it and keep its IRQ masked
+        outb(ONESHOT_MODE, COMMAND_REG);
+    }
+    else{
+        init_PIT();
+    }
+
+    for(i = 0; i < MLFQ_LEVELS; i++){
+        mlfq_quanta[i] = us_to_ticks(mlfq_quanta_us[i]);
+    }
+    mlfq_boost_ticks = us_to_ticks(MLFQ_BOOST_US);
+    need_resched = 0;
+
+    timer_start_cpu();
+
+    sti();
+}
+
+/* timer_start_cpu()
+ * Starts the scheduler clock of the processor calling it, from tick 0 and with an empty timer wheel
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: the APIC timer ticks periodically - the PIT, if that is the clock, is already running
+ *               (init_PIT) and only ever interrupts the boot processor. Call with interrupts off
+ */
+void timer_start_cpu(void){
+    cpu_t* cpu = this_cpu();
+
+    cpu->ticks = 0;
+    cpu->tick_residual = 0;
+    cpu->armed_count = 0;
+    cpu->tickless = 0;
+    cpu->tick_deadline = TICK_NO_DEADLINE;
+    ktimer_init_wheel(&cpu->timers, 0);
+    cpu->mlfq_last_tick = 0;
+    cpu->mlfq_next_boost = mlfq_boost_ticks;
 
-// initializes the PIT
+    cpu->idle_cycles = 0;
+    cpu->idle_start_tsc = 0;
+    cpu->period_start_tsc = rdtsc();
+    cpu->period_start_idle = 0;
+    cpu->period_cycles = 0;
+    cpu->period_idle_cycles = 0;
+
+    if(timer_lapic){
+        lapic_timer_periodic(tick_period);
+    }
+}
+
+/* us_to_ticks(uint32_t us)
+ * Inputs: us - a duration in microseconds
+ * Outputs: the number of scheduler ticks it takes, rounded up, at least 1
+ * Side Effects: none
+ */
+uint32_t us_to_ticks(uint32_t us){
+    uint32_t ticks = (us + tick_us - 1) / tick_us;
+    return (ticks == 0) ? 1 : ticks;
+}
+
+// initializes the PIT - the fallback scheduler clock when there is no local APIC
 void init_PIT(){
     //use channel 0 data port (0x40)
     //use Mode/Command register port (0x43) to write instructions
-    cli();
-    outb(SET_MODE, COMMAND_REG);    //set PIT to generate square waves in 16-bit binary on channel 0 with lo/hi access mode
+    outb(SET_MODE, COMMAND_REG);    //set PIT to generate a rate in 16-bit binary on channel 0 with lo/hi access mode
 
-    // we want 10 to 50 ms
-    outb(COUNTER_LO, PIT_DATA);     //send low 8-bits of counter followed by high 8 bits (counter = 59659 because 1193180/counter = 20Hz (50ms))
+    // we want 10 to 50 ms - 10ms ticks, the MLFQ quanta are a few ticks each
+    outb(COUNTER_LO, PIT_DATA);     //send low 8-bits of counter followed by high 8 bits (counter = 11932 because 1193180/counter = 100Hz (10ms))
     outb(COUNTER_HI, PIT_DATA);
 
+    tick_us = TICK_US_PIT;
+    tick_period = PIT_PERIOD;
+    timer_max_count = PIT_MAX_COUNT;
+
     enable_irq(PIT_IRQ);      //Enable IRQ on port 0 (timer chip)
-    sti();
+}
+
+/* pit_wait(uint32_t counts)
+ * Busy-waits on PIT channel 2, which leaves the scheduler's channel 0 alone
+ * Inputs: counts - PIT input clock cycles to wait, 1 to PIT_MAX_COUNT (838ns each)
+ * Outputs: none
+ * Side Effects: turns the speaker off
+ */
+void pit_wait(uint32_t counts){
+    // gate on, speaker off
+    outb((inb(PIT_CH2_GATE) & ~0x02) | 0x01, PIT_CH2_GATE);
+
+    // loading the count starts the countdown, the output goes high once it reaches 0
+    outb(PIT_CH2_ONESHOT, COMMAND_REG);
+    outb(counts & 0xFF, PIT_CH2_DATA);
+    outb((counts >> 8) & 0xFF, PIT_CH2_DATA);
+
+    while(!(inb(PIT_CH2_GATE) & PIT_CH2_OUT));
+}
+
+/* tick_account(cpu_t* cpu, uint32_t counts)
+ * Advances a processor's tick count by however many whole ticks the given timer counts add up to
+ * Inputs: cpu - the processor calling it
+ *         counts - timer counts that have passed
+ * Outputs: none
+ * Side Effects: remainder is carried over to the next call
+ */
+static void tick_account(cpu_t* cpu, uint32_t counts){
+    cpu->tick_residual += counts;
+    while(cpu->tick_residual >= tick_period){
+        cpu->tick_residual -= tick_period;
+        cpu->ticks++;
+    }
+}
+
+/* timer_oneshot(cpu_t* cpu, uint32_t count)
+ * Switches a processor's scheduler clock to one-shot mode
+ * Inputs: cpu - the processor calling it
+ *         count - timer counts until the interrupt, 0 to stop the timer altogether
+ * Outputs: none
+ * Side Effects: PIT mode 0 never fires until a count is loaded, so writing only the mode stops it
+ */
+static void timer_oneshot(cpu_t* cpu, uint32_t count){
+    if(timer_lapic){
+        lapic_timer_oneshot(count);
+    }
+    else{
+        outb(ONESHOT_MODE, COMMAND_REG);
+        if(count != 0){
+            outb(count & 0xFF, PIT_DATA);
+            outb((count >> 8) & 0xFF, PIT_DATA);
+        }
+    }
+    cpu->armed_count = count;
+    cpu->tickless = 1;
+}
+
+/* timer_remaining()
+ * Inputs: none
+ * Outputs: counts left in the pending one-shot
+ * Side Effects: after terminal count PIT mode 0 wraps around and keeps going, the APIC timer stays at 0
+ */
+static uint32_t timer_remaining(void){
+    uint32_t remaining;
+
+    if(timer_lapic){
+        return lapic_timer_current();
+    }
+
+    outb(LATCH_COUNT, COMMAND_REG);
+    remaining = inb(PIT_DATA);
+    remaining |= inb(PIT_DATA) << 8;
+    return remaining;
+}
+
+/* tick_restart()
+ * Leaves tickless mode and goes back to periodic scheduler ticks on this processor
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: catches its tick count up with the part of the one-shot that already ran, call with interrupts off
+ */
+void tick_restart(void){
+    cpu_t* cpu = this_cpu();
+    uint32_t remaining;
+
+    if(!cpu->tickless){
+        return;
+    }
+
+    if(cpu->armed_count != 0){
+        remaining = timer_remaining();
+
+        // a PIT that wrapped past its terminal count has run the whole one-shot
+        tick_account(cpu, (remaining <= cpu->armed_count) ? cpu->armed_count - remaining : cpu->armed_count);
+    }
+
+    if(timer_lapic){
+        lapic_timer_periodic(tick_period);
+    }
+    else{
+        outb(SET_MODE, COMMAND_REG);
+        outb(COUNTER_LO, PIT_DATA);
+        outb(COUNTER_HI, PIT_DATA);
+    }
+    cpu->armed_count = 0;
+    cpu->tickless = 0;
+}
+
+/* tick_sync()
+ * Catches this processor's tick count up with the part of the pending one-shot that already ran,
+ * without leaving tickless mode
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: the one-shot only accounts for the rest when it fires, call with interrupts off
+ */
+void tick_sync(void){
+    cpu_t* cpu = this_cpu();
+    uint32_t remaining, passed;
+
+    if(!cpu->tickless || cpu->armed_count == 0){
+        return;
+    }
+
+    remaining = timer_remaining();
+    passed = (remaining <= cpu->armed_count) ? cpu->armed_count - remaining : cpu->armed_count;
+    tick_account(cpu, passed);
+    cpu->armed_count -= passed;
+}
+
+/* tick_request(uint32_t tick)
+ * Makes sure a timer interrupt happens on this processor by the given tick, even while tickless
+ * Inputs: tick - value of its tick count the caller needs to run at
+ * Outputs: none
+ * Side Effects: the request is dropped once that tick is reached, callers re-request for later deadlines
+ */
+void tick_request(uint32_t tick){
+    cpu_t* cpu = this_cpu();
+
+    if(cpu->tick_deadline == TICK_NO_DEADLINE || (int32_t)(tick - cpu->tick_deadline) < 0){
+        cpu->tick_deadline = tick;
+    }
+}
+
+/* tick_update()
+ * Picks the timer mode after a scheduling decision. With more than one runnable task we need
+ * periodic ticks for preemption; otherwise the timer is armed once for the next deadline, or stopped.
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: reprograms the timer
+ */
+void tick_update(void){
+    cpu_t* cpu = this_cpu();
+    uint32_t counts;
+
+    // shells are launched off the first ticks, so stay periodic until they're all up
+    if(!booted_flag){
+        return;
+    }
+
+    if(cpu->rq.count > 0){
+        tick_restart();
+        return;
+    }
+
+    if(cpu->tick_deadline == TICK_NO_DEADLINE){
+        timer_oneshot(cpu, 0);
+        return;
+    }
+
+    if((int32_t)(cpu->tick_deadline - cpu->ticks) <= 0){
+        counts = 1;     // already due, fire right away
+    }
+    else{
+        // the PIT's 16 bit counter can't reach far deadlines, so those take a few one-shots
+        counts = (cpu->tick_deadline - cpu->ticks) * tick_period - cpu->tick_residual;
+        if((cpu->tick_deadline - cpu->ticks) > timer_max_count / tick_period + 1 || counts > timer_max_count){
+            counts = timer_max_count;
+        }
+    }
+    timer_oneshot(cpu, counts);
+}
+
+/* idle_account(cpu_t* cpu)
+ * Adds the time the processor's idle task has been halted so far to its idle_cycles
+ * Inputs: cpu - the processor calling it
+ * Outputs: none
+ * Side Effects: call with interrupts off - the hlt in progress is split at this point
+ */
+static void idle_account(cpu_t* cpu){
+    uint64_t now;
+
+    if(cpu->idle_start_tsc != 0){
+        now = rdtsc();
+        cpu->idle_cycles += now - cpu->idle_start_tsc;
+        cpu->idle_start_tsc = now;
+    }
+}
+
+/* cpu_is_idle(cpu_t* cpu)
+ * Inputs: cpu - any processor
+ * Outputs: 1 if it takes tasks and has nothing to do - it is in its idle task and its run queue is empty
+ * Side Effects: none
+ */
+static int cpu_is_idle(cpu_t* cpu){
+    return cpu->active && cpu->pid == IDLE_PID && cpu->rq.count == 0;
+}
+
+/* find_idle_cpu(int prefer)
+ * Inputs: prefer - index into cpus[] of the processor to pick if it is idle
+ * Outputs: index of an idle processor, -1 if they are all busy
+ * Side Effects: none
+ */
+static int find_idle_cpu(int prefer){
+    int i;
+
+    if(cpu_is_idle(&cpus[prefer])){
+        return prefer;
+    }
+    for(i = 0; i < num_cpus; i++){
+        if(cpu_is_idle(&cpus[i])){
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* find_busiest_cpu(int self)
+ * Inputs: self - index into cpus[] of the processor looking for work
+ * Outputs: index of the other processor with the most tasks waiting, -1 if none has any
+ * Side Effects: only peeks at the queue lengths, they may have changed by the time the caller takes the queue's lock
+ */
+static int find_busiest_cpu(int self){
+    int i;
+    int busiest = -1;
+
+    for(i = 0; i < num_cpus; i++){
+        if(i != self && cpus[i].active && cpus[i].rq.count > 0 &&
+           (busiest < 0 || cpus[i].rq.count > cpus[busiest].rq.count)){
+            busiest = i;
+        }
+    }
+    return busiest;
+}
+
+/* idle_loop()
+ * Body of the idle task: halts the CPU whenever nothing is runnable, here or on another processor's queue
+ * Inputs: none
+ * Outputs: never returns
+ * Side Effects: interrupts are serviced on the idle stack. The idle task never moves, so its processor stays the same
+ */
+static void idle_loop(void){
+    cpu_t* cpu = this_cpu();
+
+    // the switch to us holds the kernel lock - from here on only interrupts and schedule() take it, halting doesn't need it
+    kernel_lock_drop();
+
+    while(1){
+        cli();
+
+        // an interrupt woke somebody up, or another processor has more than it can run - give them the CPU
+        if(cpu->rq.count > 0 || find_busiest_cpu(cpu->index) >= 0){
+            kernel_lock();
+            schedule();
+            kernel_unlock();
+            continue;
+        }
+
+        // sti only takes effect after the next instruction, so no interrupt can sneak in before the hlt
+        cpu->idle_start_tsc = rdtsc();
+        asm volatile("sti; hlt;" ::: "memory", "cc");
+        cli();
+        idle_account(cpu);
+        cpu->idle_start_tsc = 0;
+    }
+}
+
+/* mlfq_boost(cpu_t* cpu)
+ * Moves every task queued on a processor, and the one running there, back to its base level with a fresh
+ * quantum, so CPU bound tasks that sank to the bottom can't be starved forever by interactive ones. Blocked
+ * tasks keep their level until the boost after they wake up
+ * Inputs: cpu - the processor calling it, the others boost their own tasks off their own clocks
+ * Outputs: none
+ * Side Effects: reorders its run queue, call with interrupts off
+ */
+static void mlfq_boost(cpu_t* cpu){
+    run_queue_t* rq = &cpu->rq;
+    pcb_t *task, *next;
+    int level;
+
+    spin_lock(&rq->lock);
+    // a task only ever moves up to a level that was already walked, so nothing is visited twice
+    for(level = MLFQ_TOP; level < MLFQ_LEVELS; level++){
+        for(task = rq->head[level]; task != NULL; task = next){
+            next = task->rq_next;
+            if(task->prio_level != task->base_level){
+                rq_unlink(rq, task);
+                task->prio_level = task->base_level;
+                rq_link(rq, task);
+            }
+            task->quantum_left = mlfq_quanta[task->base_level];
+        }
+    }
+    spin_unlock(&rq->lock);
+
+    if(cpu->pid != IDLE_PID){
+        task = get_pcb_from_pid(cpu->pid);
+        mlfq_set_level(task, task->base_level);
+    }
+}
+
+/* mlfq_tick()
+ * Charges the elapsed ticks to the running task and decides whether it should be preempted
+ * Inputs: none
+ * Outputs: 1 if the scheduler should pick another task, 0 to keep running the current one
+ * Side Effects: demotes the running task when its quantum runs out, boosts periodically
+ */
+static int mlfq_tick(void){
+    cpu_t* cpu = this_cpu();
+    pcb_t* curr_pcb;
+    uint32_t elapsed;
+    int level;
+
+    elapsed = cpu->ticks - cpu->mlfq_last_tick;
+    cpu->mlfq_last_tick = cpu->ticks;
+
+    // shells are launched off the first ticks
+    if(booted_terms < MAX_TERMINALS){
+        return 1;
+    }
+
+    if((int32_t)(cpu->ticks - cpu->mlfq_next_boost) >= 0){
+        cpu->mlfq_next_boost = cpu->ticks + mlfq_boost_ticks;
+        mlfq_boost(cpu);
+    }
+
+    // the idle task has no quantum, it only gives way when somebody woke up
+    if(curr_pid == IDLE_PID){
+        return cpu->rq.count > 0;
+    }
+
+    curr_pcb = get_pcb_from_pid(curr_pid);
+    if(elapsed >= (uint32_t)curr_pcb->quantum_left){
+        // used up its quantum - sink one level (the bottom level just round robins)
+        level = curr_pcb->prio_level;
+        if(level < MLFQ_BOTTOM){
+            level++;
+        }
+        mlfq_set_level(curr_pcb, level);
+        return cpu->rq.count > 0;
+    }
+    curr_pcb->quantum_left -= elapsed;
+
+    // preempt as soon as a task at a higher level is runnable
+    for(level = MLFQ_TOP; level < curr_pcb->prio_level; level++){
+        if(cpu->rq.head[level] != NULL){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* timer_tick()
+ * Scheduler clock interrupt, whichever timer it came from
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: may switch to another task
+ */
+static void timer_tick(void){
+    cpu_t* cpu = this_cpu();
+    uint64_t now;
+
+    // utilization of the period that just ended = 1 - period_idle_cycles / period_cycles
+    idle_account(cpu);
+    now = rdtsc();
+    cpu->period_cycles = (uint32_t)(now - cpu->period_start_tsc);
+    cpu->period_idle_cycles = (uint32_t)(cpu->idle_cycles - cpu->period_start_idle);
+    cpu->period_start_tsc = now;
+    cpu->period_start_idle = cpu->idle_cycles;
+
+    // a one-shot covers however many counts it was armed with, a periodic interrupt exactly one tick
+    if(cpu->tickless){
+        tick_account(cpu, cpu->armed_count);
+        cpu->armed_count = 0;
+    }
+    else{
+        tick_account(cpu, tick_period);
+    }
+
+    if(cpu->tick_deadline != TICK_NO_DEADLINE && (int32_t)(cpu->ticks - cpu->tick_deadline) >= 0){
+        cpu->tick_deadline = TICK_NO_DEADLINE;
+    }
+
+    // expired kernel timers run first, so tasks they wake are already queued for the decision below
+    ktimer_run();
+
+    /*If the running task used up its quantum or something more important is waiting, switch process*/
+    if(mlfq_tick() || need_resched){
+        schedule();
+    }
+    else{
+        // keep the timer mode in step with the run queue - arm the next one-shot, or stop ticking
+        tick_update();
+    }
 }
 
 /*Function called upon interrupt fired by PIT*/
 void PIT_handler(){
     send_eoi(PIT_IRQ);
+    timer_tick();
+}
 
-    /*If more than one active terminal running, switch process*/
-    schedule();
+/* lapic_timer_handler()
+ * Local APIC timer interrupt - the scheduler clock when the APIC is available
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: may switch to another task
+ */
+void lapic_timer_handler(void){
+    lapic_eoi();
+    timer_tick();
+}
 
+/* resched_handler()
+ * Reschedule IPI from another processor: it queued a task here, or took one away, or switched the terminal
+ * on screen - which changes where the running task's vidmap page has to point
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: may switch to another task
+ */
+void resched_handler(void){
+    lapic_eoi();
 
-    /*
-    need a way to keep track of list of pids
-    current pid is important, as well as order
-    i.e. fish1 (T1) -> fish3 (T3) -> fish2 (T2)
-    
-    how to account for when program is done? do round robin
-    */
+    if(curr_pid != IDLE_PID){
+        scheduling_vidmap(scheduled_process, curr_term);
+    }
 
+    // the idle task picks up whatever was queued, a busy processor may have to start ticking again for it
+    if(need_resched || curr_pid == IDLE_PID){
+        schedule();
+    }
+    else{
+        tick_update();
+    }
 }
 
 /* initial_boot()
@@ -61,6 +593,7 @@ void initial_boot() {
         terminals[i].buf_idx = 0;
         terminals[i].ac_repeats = 0;
         terminals[i].history_idx = 0;
+        wq_init(&terminals[i].read_wq);
 
     }
 
@@ -73,25 +606,380 @@ void initial_boot() {
 
     // set process to be 0 in preparation for the first terminal, and then start round robin
     scheduled_process = 0;
+    booted_terms = 0;
 
-    for (i = 0; i < 3; i++){
-        scheduling_array[i] = -1;
+    sched_init_cpu(0);
+}
+
+/* sched_init_cpu(int idx)
+ * Sets up a processor's run queue and its idle task
+ * Inputs: idx - index into cpus[]
+ * Outputs: none
+ * Side Effects: the idle task starts in idle_loop the first time the processor switches to it
+ */
+void sched_init_cpu(int idx){
+    cpu_t* cpu = &cpus[idx];
+    pcb_t* idle;
+    int i;
+
+    // nothing is runnable until the first task is queued
+    for(i = 0; i < MLFQ_LEVELS; i++){
+        cpu->rq.head[i] = NULL;
+        cpu->rq.tail[i] = NULL;
+    }
+    cpu->rq.count = 0;
+    cpu->rq.lock.locked = 0;
+
+    // the idle task never goes on a run queue, the scheduler falls back to it when there is nothing else
+    idle = (pcb_t*)idle_stacks[idx];
+    idle->pid = IDLE_PID;
+    idle->state = TASK_RUNNABLE;
+    idle->cpu = idx;
+    idle->last_cpu = idx;
+    idle->term_id = 0;
+    idle->prio_level = MLFQ_BOTTOM;
+    idle->base_level = MLFQ_BOTTOM;
+    idle->start_tsc = rdtsc();
+    idle->user_cycles = 0;
+    idle->kernel_cycles = 0;
+    idle->acct_stamp = idle->start_tsc;
+    idle->acct_mode = ACCT_KERNEL;
+    idle->nr_switches = 0;
+    idle->nr_syscalls = 0;
+    idle->sc_stats = NULL;
+    idle->switch_cycles = 0;
+    idle->base_kernel_stack = (uint32_t)idle_stacks[idx] + EIGHT_KB;
+    // the first switch to the idle task starts idle_loop at the top of its stack
+    idle->ctx.ebx = 0;
+    idle->ctx.esi = 0;
+    idle->ctx.edi = 0;
+    idle->ctx.esp = idle->base_kernel_stack - 4;
+    idle->ctx.ebp = 0;
+    idle->ctx.eip = (uint32_t)idle_loop;
+
+    cpu->idle = idle;
+}
+
+/* rq_link(run_queue_t* rq, pcb_t* task)
+ * Appends a task to the tail of its level's queue
+ * Inputs: rq - run queue, locked by the caller
+ *         task - pcb of the task to queue
+ * Outputs: none
+ * Side Effects: O(1)
+ */
+static void rq_link(run_queue_t* rq, pcb_t* task){
+    int level = task->prio_level;
+
+    task->rq_next = NULL;
+    task->rq_prev = rq->tail[level];
+
+    if(rq->tail[level] != NULL){
+        rq->tail[level]->rq_next = task;
+    }
+    else{
+        rq->head[level] = task;
+    }
+    rq->tail[level] = task;
+    rq->count++;
+}
+
+/* rq_unlink(run_queue_t* rq, pcb_t* task)
+ * Unlinks a task from anywhere in its level's queue
+ * Inputs: rq - run queue the task is on, locked by the caller
+ *         task - pcb of the task
+ * Outputs: none
+ * Side Effects: O(1)
+ */
+static void rq_unlink(run_queue_t* rq, pcb_t* task){
+    int level = task->prio_level;
+
+    if(task->rq_prev != NULL){
+        task->rq_prev->rq_next = task->rq_next;
+    }
+    else{
+        rq->head[level] = task->rq_next;
+    }
+
+    if(task->rq_next != NULL){
+        task->rq_next->rq_prev = task->rq_prev;
+    }
+    else{
+        rq->tail[level] = task->rq_prev;
+    }
+
+    task->rq_next = NULL;
+    task->rq_prev = NULL;
+    rq->count--;
+}
+
+/* rq_pop(run_queue_t* rq)
+ * Pops the task at the head of the highest non-empty level
+ * Inputs: rq - run queue, locked by the caller
+ * Outputs: pcb of the task, NULL if the queue is empty
+ * Side Effects: O(MLFQ_LEVELS)
+ */
+static pcb_t* rq_pop(run_queue_t* rq){
+    int level;
+    pcb_t* next;
+
+    for(level = MLFQ_TOP; level < MLFQ_LEVELS; level++){
+        next = rq->head[level];
+        if(next != NULL){
+            rq_unlink(rq, next);
+            return next;
+        }
+    }
+    return NULL;
+}
+
+/* rq_enqueue(pcb_t* task)
+ * Appends a runnable task to the tail of the run queue for its MLFQ level, on the processor in task->cpu
+ * Inputs: task - pcb of the task to queue
+ * Outputs: none
+ * Side Effects: O(1), must be called with interrupts disabled
+ */
+void rq_enqueue(pcb_t* task){
+    run_queue_t* rq = &cpus[task->cpu].rq;
+
+    spin_lock(&rq->lock);
+    rq_link(rq, task);
+    spin_unlock(&rq->lock);
+}
+
+/* rq_remove(pcb_t* task)
+ * Unlinks a task from anywhere in its level's run queue
+ * Inputs: task - pcb of a task currently on a queue
+ * Outputs: none
+ * Side Effects: O(1), must be called with interrupts disabled
+ */
+void rq_remove(pcb_t* task){
+    run_queue_t* rq = &cpus[task->cpu].rq;
+
+    spin_lock(&rq->lock);
+    rq_unlink(rq, task);
+    spin_unlock(&rq->lock);
+}
+
+/* rq_steal(cpu_t* cpu)
+ * Takes the next task off the processor with the most tasks waiting
+ * Inputs: cpu - the processor calling it, which has nothing of its own to run
+ * Outputs: pcb of the task, now belonging to cpu, NULL if nobody has anything waiting
+ * Side Effects: must be called with interrupts disabled
+ */
+static pcb_t* rq_steal(cpu_t* cpu){
+    int victim = find_busiest_cpu(cpu->index);
+    run_queue_t* rq;
+    pcb_t* task;
+
+    if(victim < 0){
+        return NULL;
     }
+
+    rq = &cpus[victim].rq;
+    spin_lock(&rq->lock);
+    task = rq_pop(rq);
+    spin_unlock(&rq->lock);
+
+    if(task != NULL){
+        task->cpu = cpu->index;
+    }
+    return task;
+}
+
+/* rq_pick_next()
+ * Pops the task at the head of the highest non-empty level of this processor's queue, or takes
+ * one from another processor's if that is empty
+ * Inputs: none
+ * Outputs: pcb of the next task to run, NULL if nothing is runnable
+ * Side Effects: O(MLFQ_LEVELS + processors), must be called with interrupts disabled
+ */
+pcb_t* rq_pick_next(void){
+    cpu_t* cpu = this_cpu();
+    pcb_t* next;
+
+    spin_lock(&cpu->rq.lock);
+    next = rq_pop(&cpu->rq);
+    spin_unlock(&cpu->rq.lock);
+
+    if(next == NULL){
+        next = rq_steal(cpu);
+    }
+    return next;
+}
+
+/* rq_wake(pcb_t* task)
+ * Queues a task that was just woken up on the processor it last ran on, where its cache is warm - unless
+ * that one is busy and another one is idle
+ * Inputs: task - pcb of the woken task, runnable and on no queue
+ * Outputs: none
+ * Side Effects: interrupts the processor it went to if that isn't us, so it picks the task up (or starts
+ *               ticking again for it), must be called with interrupts disabled
+ */
+void rq_wake(pcb_t* task){
+    int target = task->cpu;
+
+    if(!cpu_is_idle(&cpus[target])){
+        target = find_idle_cpu(this_cpu()->index);
+        if(target < 0){
+            target = task->cpu;
+        }
+    }
+
+    task->cpu = target;
+    rq_enqueue(task);
+
+    if(target != this_cpu()->index){
+        smp_resched(target);
+    }
+}
+
+/* task_running(pcb_t* task)
+ * Inputs: task - pcb of any live task
+ * Outputs: 1 if a processor is running it right now, 0 if it is waiting or on a run queue
+ * Side Effects: none
+ */
+int task_running(pcb_t* task){
+    return cpus[task->cpu].pid == task->pid;
+}
+
+/* mlfq_set_level(pcb_t* task, int level)
+ * Puts a task at the given MLFQ level with a full quantum for that level
+ * Inputs: task - pcb of any live task
+ *         level - MLFQ_TOP to MLFQ_BOTTOM
+ * Outputs: none
+ * Side Effects: a task waiting on a run queue moves to the tail of the new level's queue,
+ *               must be called with interrupts disabled
+ */
+void mlfq_set_level(pcb_t* task, int level){
+    // runnable and not running means it sits on a queue
+    int queued = (task->state == TASK_RUNNABLE && !task_running(task));
+
+    if(queued){
+        rq_remove(task);
+    }
+    task->prio_level = level;
+    task->quantum_left = mlfq_quanta[level];
+    if(queued){
+        rq_enqueue(task);
+    }
+}
+
+/* wakeup_preempt(pcb_t* task)
+ * Gives a task that was just woken by input a full quantum at its base level, and flags a reschedule
+ * if that puts it at or above the task running on its processor - so it runs when the interrupt returns
+ * (or the processor takes the IPI rq_wake sent), not at the next tick
+ * Inputs: task - woken task, already on a run queue
+ * Outputs: none
+ * Side Effects: sets need_resched of the task's processor, must be called with interrupts disabled
+ */
+void wakeup_preempt(pcb_t* task){
+    cpu_t* cpu;
+
+    // shells are still being launched off the timer
+    if(!booted_flag){
+        return;
+    }
+
+    mlfq_set_level(task, task->base_level);
+
+    // another processor only looks at the flag once it gets the kernel lock, so the flag is set before it checks
+    cpu = &cpus[task->cpu];
+    if(cpu->pid == IDLE_PID || task->prio_level <= get_pcb_from_pid(cpu->pid)->prio_level){
+        cpu->resched = 1;
+    }
+}
+
+/* acct_update(pcb_t* task)
+ * Adds the time since the task's last update to its user or kernel counter
+ * Inputs: task - pcb of the running task
+ * Outputs: none
+ * Side Effects: interrupts are charged to whatever mode they interrupted
+ */
+void acct_update(pcb_t* task){
+    uint64_t now = rdtsc();
+
+    if(task->acct_mode == ACCT_USER){
+        task->user_cycles += now - task->acct_stamp;
+    }
+    else{
+        task->kernel_cycles += now - task->acct_stamp;
+    }
+    task->acct_stamp = now;
+}
+
+/* acct_start(pcb_t* task)
+ * Starts charging time to a task that is being switched in
+ * Inputs: task - pcb of the task about to run
+ * Outputs: none
+ * Side Effects: counts the switch
+ */
+void acct_start(pcb_t* task){
+    task->acct_stamp = rdtsc();
+    task->nr_switches++;
+}
+
+/* acct_syscall_enter(uint32_t nr)
+ * Switches the running task's clock to kernel time and counts the system call
+ * Inputs: nr - the system call number, unchecked
+ * Outputs: none
+ * Side Effects: called by the system call linkage with interrupts off. Nothing here allocates - execute gave the task its table
+ */
+void acct_syscall_enter(uint32_t nr){
+    pcb_t* curr_pcb = get_pcb_from_pid(curr_pid);
+
+    acct_update(curr_pcb);
+    curr_pcb->acct_mode = ACCT_KERNEL;
+    curr_pcb->nr_syscalls++;
+
+    curr_pcb->sc_idx = SYSSTATS_IDX(nr);
+    curr_pcb->sc_start = curr_pcb->acct_stamp;
+    sysstats_enter(curr_pcb->sc_stats, curr_pcb->sc_idx);
+}
+
+/* acct_syscall_exit(int32_t ret)
+ * Switches the running task's clock back to user time and records how the system call went
+ * Inputs: ret - what the call returned
+ * Outputs: none
+ * Side Effects: called by the system call linkage with interrupts off - after halt this is the parent
+ *               returning from execute, so the parent is the one charged, and the latency is that of its execute
+ */
+void acct_syscall_exit(int32_t ret){
+    pcb_t* curr_pcb = get_pcb_from_pid(curr_pid);
+
+    acct_update(curr_pcb);
+    curr_pcb->acct_mode = ACCT_USER;
+    sysstats_exit(curr_pcb->sc_stats, curr_pcb->sc_idx, ret, curr_pcb->acct_stamp - curr_pcb->sc_start);
+}
+
+/* boot_shell()
+ * Entry point of the context that launches a terminal's root shell on a fresh kernel stack
+ * Inputs: none
+ * Outputs: never returns - the shell runs until it halts, and halt restarts it
+ * Side Effects: none
+ */
+static void boot_shell(void){
+    sys_execute((uint8_t*)"shell");
 }
 
 /*Change currently scheduled process to next in scheduling queue*/
 void schedule(){
 
-    int next_scheduling_term;
-    int curr_esp;
-    int curr_ebp;
+    cpu_t* cpu = this_cpu();
+
+    // pcb of whatever task the timer interrupted
+    pcb_t* curr_pcb;
+    pcb_t* next_pcb;
+    context_t boot_ctx;
+    int lock_depth;
+    int idle_cpu;
 
     // ---------------------------------------------        BOOT        --------------------------------------------- //
     // BAND-AID SOLUTION DONT FIX WHATS NOT BROKEN
 
     // need to BOOT first terminal
-    if(scheduling_array[0] == -1){
+    if(booted_terms == 0){
         // if not first terminal, map to backup buffers instead of actual video memory (because at start, we are looking at term 1)
+        booted_terms++;
 
         scheduling_vidmap(scheduled_process, curr_term);
         // send_eoi(PIT_IRQ);
@@ -99,112 +987,115 @@ void schedule(){
         return;
     }
 
-    // save current ebp/esp (for the current pcb)
-    asm volatile(
-
-        "movl %%ebp, %0;"
-        "movl %%esp, %1;"
+    curr_pcb = get_pcb_from_pid(curr_pid);
 
-        : "=r"(curr_ebp), "=r"(curr_esp)
-    );
-
-    // get pcb bc first shell has pid 0
-    pcb_t* curr_pcb;
-    pcb_t* next_pcb;
-    curr_pcb = get_pcb_from_pid(scheduling_array[scheduled_process]);
-    // curr_pcb->old_ebp = curr_ebp;
-    // curr_pcb->old_esp = curr_esp;
-    
-    curr_pcb->schedule_ebp = curr_ebp;
-    curr_pcb->schedule_esp = curr_esp;
-
-    next_scheduling_term = ((1+scheduled_process) % 3);     // mod 3 because 3 terminals at most
+    // preempted task goes to the back of the line if it can still run
+    if(curr_pcb->state == TASK_RUNNABLE && curr_pcb != idle_task){
+        rq_enqueue(curr_pcb);
+    }
 
-    // need to BOOT the SECOND terminal
-    if(scheduling_array[1] == -1){
-        scheduled_process = 1;
-        // switch_coords(0, 1);
+    // need to BOOT the SECOND and THIRD terminals
+    if(booted_terms < MAX_TERMINALS){
+        scheduled_process = booted_terms;
+        booted_terms++;
+        if(booted_terms == MAX_TERMINALS){
+            booted_flag = 1;
 
-        int ebp = 0x800000 - (scheduled_process) * 0x2000;
-        int esp = ebp;
+            // the other processors can take tasks from here on - as long as they have a clock of their own, the PIT only ticks here
+            smp_go = timer_lapic;
+        }
 
         scheduling_vidmap(scheduled_process, curr_term);
-        // switch_coords(0, 1);
 
-        asm volatile(
-            // literally save ebp and esp into (free to clobber) registers
-            "movl %0, %%ebp;"
-            "movl %1, %%esp;"
-            
-            : // no outputs
-            : "r"(ebp), "r"(esp)    //we might need way to save esp/ebp after context switch in execute (instead of old parent's esp/ebp)
-        );
+        // launch the shell from one of the boot stacks below 8MB, with a dummy return address slot. execute gives the
+        // shell a kernel stack of its own, so the boot stack is left behind once the shell is in user space
+        boot_ctx.ebx = 0;
+        boot_ctx.esi = 0;
+        boot_ctx.edi = 0;
+        boot_ctx.esp = EIGHT_MB - (scheduled_process) * EIGHT_KB - 4;
+        boot_ctx.ebp = 0;
+        boot_ctx.eip = (uint32_t)boot_shell;
+        lock_depth = cpu->lock_depth;
+        switch_to(&curr_pcb->ctx, &boot_ctx);
 
-        sys_execute((uint8_t*)"shell");
+        // the kernel lock is the processor's, how deep we hold it is ours
+        this_cpu()->lock_depth = lock_depth;
         return;
     }
 
-    // BOOT THIRD TERMINAL AHHHHHH
-    if(scheduling_array[2] == -1){
-        scheduled_process = 2;
-        booted_flag = 1;
-        // switch_coords(1,2);
+    // --------------------------------------------- normal scheduling --------------------------------------------- //
 
-        int ebp = 0x800000 - (scheduled_process) * 0x2000;
-        int esp = ebp;
+    need_resched = 0;
 
-        scheduling_vidmap(scheduled_process, curr_term);
-        // switch_coords(1,2);
-
-        asm volatile(
-            // literally save ebp and esp into (free to clobber) registers
-            "movl %0, %%ebp;"
-            "movl %1, %%esp;"
-            
-            : // no outputs
-            : "r"(ebp), "r"(esp)    //we might need way to save esp/ebp after context switch in execute (instead of old parent's esp/ebp)
-            // : "r"(pcb->old_ebp), "r"(pcb->old_esp)    //we might need way to save esp/ebp after context switch in execute (instead of old parent's esp/ebp)
-        );
+    // run whatever is at the head of the run queue - this is independent of which terminal the task belongs to
+    next_pcb = rq_pick_next();
 
-        sys_execute((uint8_t*)"shell");
-        return;
+    // with at most one runnable task nothing can be preempted, so drop to one-shot timer interrupts
+    tick_update();
+
+    // nothing runnable, not even the current task - halt in the idle task
+    if(next_pcb == NULL){
+        next_pcb = idle_task;
     }
 
-    // --------------------------------------------- normal scheduling --------------------------------------------- //
+    // more is waiting here than we can run - an idle processor can take some of it
+    if(cpu->rq.count > 0){
+        idle_cpu = find_idle_cpu(cpu->index);
+        if(idle_cpu >= 0 && idle_cpu != cpu->index){
+            smp_resched(idle_cpu);
+        }
+    }
+
+    // picked the task that was already running (it was the only one on the queue)
+    if(next_pcb == curr_pcb){
+        return;
+    }
 
-    // video remapping
-    // if scheduled_process == curr_term, then don't need to do anything because it's already mapped to physical vid addr (0xB8000), we did this in checkpoint 4
-    // if NOT equal, then need to change mapping to map to background buffers in physical memory
+    acct_update(curr_pcb);
+    acct_start(next_pcb);
 
     // finally switch it
-    scheduled_process = next_scheduling_term;
+    curr_pid = next_pcb->pid;
 
-    next_pcb = get_pcb_from_pid(scheduling_array[next_scheduling_term]);
-    curr_pid = next_pcb->curr_pid;
+    // the idle task runs on its own stack and never touches user memory, so leave the TSS and paging alone
+    if(next_pcb != idle_task){
+        scheduled_process = next_pcb->term_id;
 
-    /* Restore next process' TSS */
-    tss.ss0 = KERNEL_DS;
-    // tss.esp0 = next_pcb->old_esp0;
-    tss.esp0 = 0x800000 - (scheduling_array[next_scheduling_term]) * 0x2000;      // 8MB - (pid)*8kB
+        /* Restore next process' TSS */
+        cpu->tss.ss0 = KERNEL_DS;
+        cpu->tss.esp0 = next_pcb->base_kernel_stack;      // 8MB - (pid)*8kB
 
-    /*Remap user 128MB to new user program*/ 
-    map_user_program(scheduling_array[next_scheduling_term]);
+        /*Remap user 128MB to new user program*/ 
+        map_user_program(next_pcb->user_page_table, next_pcb->mmap_page_table);
 
-    // video remapping 
-    scheduling_vidmap(next_scheduling_term, curr_term);
+        // it ran on another processor since it was last here, and may have changed its page tables there
+        if(next_pcb->last_cpu != cpu->index){
+            next_pcb->last_cpu = cpu->index;
+            flush_tlb();
+        }
 
-    // switch coords
-    // switch_coords(prev_process, next_scheduling_term);
+        // video remapping
+        // if the task's terminal is the one on screen, map to physical vid addr (0xB8000), otherwise to its background buffer
+        scheduling_vidmap(scheduled_process, curr_term);
+    }
 
-    /* Switch ESP and EBP to next processes kernel stack */
-    asm volatile(
-        // literally save ebp and esp into (free to clobber) registers
-        "movl %0, %%ebp;"
-        "movl %1, %%esp;"
-        
-        : // no outputs
-        : "r"(next_pcb->schedule_ebp), "r"(next_pcb->schedule_esp)    //we might need way to save esp/ebp after context switch in execute (instead of old parent's esp/ebp)
-    );
+    // none of the time the idle task ran is charged to the next task's quantum
+    if(curr_pcb == idle_task){
+        cpu->mlfq_last_tick = cpu->ticks;
+    }
+
+    /* Save our registers and load the next task's - we come back here when somebody switches back to us */
+    lock_depth = cpu->lock_depth;
+    cpu->switch_start_tsc = rdtsc();
+    switch_to(&curr_pcb->ctx, &next_pcb->ctx);
+
+    // whoever switched back to us may have taken us off another processor's queue - the kernel lock came along
+    // with the switch, and how deep we hold it is ours
+    cpu = this_cpu();
+    cpu->lock_depth = lock_depth;
+
+    // the cost of the switch is charged to the task that was switched to, which is us now
+    curr_pcb->switch_cycles += (uint32_t)(rdtsc() - cpu->switch_start_tsc);
     
     // send_eoi(PIT_IRQ);
 }
@@ -2,34 +2,173 @@
 #define _SCHEDULE_H
 
 #include "i8259.h"
+#include "types.h"
+#include "lib.h"
+
+// pcb_t embeds this, and syscall.h includes this file - so it has to come before syscall.h is pulled in
+// registers switch_to saves for a task that is switched out - only the callee-saved ones, the rest are
+// dead across the call. The offsets are used by context_switch.S, keep them in sync
+typedef struct context {
+    uint32_t ebx;       // 0
+    uint32_t esi;       // 4
+    uint32_t edi;       // 8
+    uint32_t ebp;       // 12
+    uint32_t esp;       // 16 - stack pointer as it is after switch_to returns
+    uint32_t eip;       // 20 - where switch_to returns to
+} context_t;
+
+// saves the running task's registers in prev and continues with next - returns once somebody switches back to prev
+extern void switch_to(context_t* prev, context_t* next);
+
+// multi-level feedback queue: level 0 is the highest priority and has the shortest quantum
+#define MLFQ_LEVELS     3
+#define MLFQ_TOP        0
+#define MLFQ_BOTTOM     (MLFQ_LEVELS - 1)
+#define MLFQ_QUANTA_US  {20000, 40000, 80000}   // how long a task may run at each level before it is demoted
+#define MLFQ_BOOST_US   1000000                 // every second everybody goes back to their base level
+
+// ready queues of runnable tasks, one per level - the running task is NOT on a queue, it is re-queued at the tail when preempted.
+// Every processor has one (cpu_t in smp.h embeds it, and smp.h is pulled in by syscall.h, so this also has to come first).
+// pcb_t lives in syscall.h (which includes this file), so use the struct tag here
+struct pcb;
+typedef struct run_queue {
+    struct pcb* head[MLFQ_LEVELS];  // next task to run at each level
+    struct pcb* tail[MLFQ_LEVELS];  // most recently queued task at each level
+    volatile int count;             // number of tasks on all levels - other processors peek at it without the lock
+    spinlock_t lock;                // processors that take work from each other's queues
+} run_queue_t;
+
 #include "syscall.h"
 
 // all from OSDEV
 #define PIT_DATA        0x40
 #define COMMAND_REG     0x43
-#define SET_MODE        0x36
+#define SET_MODE        0x34    // channel 0, lo/hi, mode 2 (rate generator) - counts down once per period so it can be latched
+#define ONESHOT_MODE    0x30    // channel 0, lo/hi, mode 0 (interrupt on terminal count) - fires once, then stays quiet
+#define LATCH_COUNT     0x00    // latch channel 0's current count for reading
 
 #define PIT_IRQ         0
-#define COUNTER_LO      0x0B 
-#define COUNTER_HI      0xE9
+#define COUNTER_LO      0x9C    // counter = 11932 -> 1193180/11932 = 100Hz (10ms ticks), quanta are whole ticks
+#define COUNTER_HI      0x2E
+#define PIT_PERIOD      ((COUNTER_HI << 8) | COUNTER_LO)   // PIT counts per scheduler tick
+#define PIT_MAX_COUNT   0xFFFF                              // longest one-shot the 16-bit counter can do
+
+#define TICK_NO_DEADLINE 0xFFFFFFFF
+
+// length of a scheduler tick - the APIC timer is cheap to rearm, so it can tick much finer than the PIT
+#define TICK_US_PIT     10000   // PIT_PERIOD at 1193180Hz
+#define TICK_US_LAPIC   500
+
+// channel 2 is only wired to the speaker, so it is free for busy-wait delays
+#define PIT_CH2_DATA    0x42
+#define PIT_CH2_GATE    0x61    // bit 0 gates channel 2, bit 1 drives the speaker, bit 5 reads channel 2's output
+#define PIT_CH2_ONESHOT 0xB0    // channel 2, lo/hi, mode 0 (output goes high at terminal count)
+#define PIT_CH2_OUT     0x20
+#define PIT_FREQ        1193182 // PIT input clock in Hz
+
+// task states (pcb->state)
+#define TASK_RUNNABLE   0       // on the run queue, or currently running
+#define TASK_WAITING    1       // blocked (parent waiting on a child in execute, ...)
+#define TASK_DEAD       2       // halted, pcb slot may be reused
 
-// the terminal that is currently executing its process (in the round robin). This is an index into scheduling_array
-int scheduled_process;
-int old_scheduled_process;
+// the terminal that owns the task running on this processor (used for video mapping and terminal read/write)
+#define scheduled_process   (this_cpu()->term)
 
 //Flag to determine if we've booted all three terminals and then must reset curr_term
 int booted_flag;
 
-// scheduling array - at most 3 processes running (per Aamir). These are the pids
-int scheduling_array[3];
+// number of terminals that have had their root shell launched so far (0-3)
+int booted_terms;
+
+// the idle task has no pid - curr_pid is IDLE_PID while it runs
+#define IDLE_PID        -1
+
+// pcb of this processor's idle task, at the bottom of its own 8kB stack so get_pcb_ptr() works on it
+#define idle_task       (this_cpu()->idle)
+
+// sets up a processor's run queue, and its idle task - which runs whenever the queue is empty and there is nothing to take from others
+void sched_init_cpu(int idx);
+
+// run queue operations - all O(1) and on the queue of the processor in task->cpu, call with interrupts off
+void rq_enqueue(struct pcb* task);
+void rq_remove(struct pcb* task);
+
+// pops the next task off this processor's queue, or failing that takes one from the busiest other queue
+struct pcb* rq_pick_next(void);
+
+// queues a task that was just woken up, on the processor it last ran on unless that one is busy and another is idle
+void rq_wake(struct pcb* task);
+
+// 1 if the task is running on a processor right now (it is then on no queue)
+int task_running(struct pcb* task);
+
+// move a task to another MLFQ level, requeueing it if it is waiting on a run queue
+void mlfq_set_level(struct pcb* task, int level);
+
+// set when a task that should run before the current one was woken - interrupt handlers call schedule() on exit if it is
+#define need_resched    (this_cpu()->resched)
+
+// boost a freshly woken task and ask its processor for a reschedule if it should run right away
+void wakeup_preempt(struct pcb* task);
+
+// reschedule IPI: the sender queued work for this processor, took some away, or switched the terminal on screen
+void resched_handler(void);
+
+// which of a task's CPU time counters is running (pcb->acct_mode)
+#define ACCT_USER       0
+#define ACCT_KERNEL     1
+
+// charge the time since the last update to the task's current mode
+void acct_update(struct pcb* task);
+
+// restart a task's clock when it is switched in, so time it spent switched out isn't charged
+void acct_start(struct pcb* task);
+
+// called from the system call linkage on the way in (with the call number) and out (with the return value),
+// with interrupts off
+void acct_syscall_enter(uint32_t nr);
+void acct_syscall_exit(int32_t ret);
+
+// the tick count, one-shot state and tick deadline are per processor (cpu_t in smp.h), what is
+// shared is the calibration below
+
+// microseconds per scheduler tick (TICK_US_LAPIC or TICK_US_PIT)
+uint32_t tick_us;
+
+// 1 if the local APIC timer is the scheduler clock, 0 if the PIT is
+int timer_lapic;
 
 // BOOT
 void initial_boot(void);
 
-// initialize the PIT
+// ask for a timer interrupt on this processor no later than the given tick of its clock, even while tickless
+void tick_request(uint32_t tick);
+
+// go back to periodic ticks because a second task became runnable
+void tick_restart(void);
+
+// bring this processor's tick count up to date in the middle of a one-shot
+void tick_sync(void);
+
+// reprogram this processor's timer for the run queue and its tick deadline - periodic, one-shot or stopped
+void tick_update(void);
+
+// picks and calibrates the scheduler clock: local APIC timer if possible, PIT otherwise, and starts it on this processor
+void init_timer(void);
+
+// starts this processor's own scheduler clock with the calibration init_timer came up with
+void timer_start_cpu(void);
+
+// converts a duration to scheduler ticks, rounding up
+uint32_t us_to_ticks(uint32_t us);
+
+// initialize the PIT as the scheduler clock
 void init_PIT(void);
 
-// PIT handler
+// busy-wait for the given number of PIT counts (at most PIT_MAX_COUNT) on channel 2 - usable before interrupts are on
+void pit_wait(uint32_t counts);
+
+// PIT handler (the APIC timer's is in lapic.h)
 extern void PIT_handler();
 
 /*Change currently scheduled process to next in scheduling queue*/
@@ -0,0 +1,455 @@
+/* smp.c - Multiprocessor discovery and application processor startup
+ */
+
+#include "smp.h"
+#include "lib.h"
+#include "x86_desc.h"
+#include "schedule.h"
+#include "syscall.h"
+
+// one small stack per application processor - they only run ap_main on it, then move to their idle task's
+static uint8_t ap_stacks[SMP_MAX_CPUS][AP_STACK_SIZE] __attribute__((aligned(16)));
+
+// the big kernel lock, see kernel_lock()
+static spinlock_t kernel_big_lock;
+
+/* mp_checksum(void* addr, uint32_t len)
+ * Inputs: addr - start of an MP structure
+ *         len - its length in bytes
+ * Outputs: sum of its bytes, 0 if the structure is valid
+ * Side Effects: none
+ */
+static uint8_t mp_checksum(void* addr, uint32_t len){
+    uint8_t sum = 0;
+    uint8_t* byte = (uint8_t*)addr;
+    uint32_t i;
+
+    for(i = 0; i < len; i++){
+        sum += byte[i];
+    }
+    return sum;
+}
+
+/* mp_search(uint32_t start, uint32_t len)
+ * Looks for the MP floating pointer structure, which is always 16 byte aligned
+ * Inputs: start - physical address to start at
+ *         len - bytes to search
+ * Outputs: the structure, NULL if it isn't in the range
+ * Side Effects: none
+ */
+static mp_fp_t* mp_search(uint32_t start, uint32_t len){
+    uint32_t addr;
+
+    for(addr = start; addr + sizeof(mp_fp_t) <= start + len; addr += 16){
+        if(((mp_fp_t*)addr)->signature == MP_FP_SIG && mp_checksum((void*)addr, sizeof(mp_fp_t)) == 0){
+            return (mp_fp_t*)addr;
+        }
+    }
+    return NULL;
+}
+
+/* mp_find()
+ * Searches the places the MP spec allows: the first KB of the EBDA, the last KB of
+ * base memory, then the BIOS ROM
+ * Inputs: none
+ * Outputs: the MP floating pointer structure, NULL on a uniprocessor machine without one
+ * Side Effects: reads low physical memory, so paging must still be off
+ */
+static mp_fp_t* mp_find(void){
+    mp_fp_t* fp;
+    uint32_t ebda = (uint32_t)(*(uint16_t*)BDA_EBDA_SEG) << 4;
+    uint32_t base_mem = (uint32_t)(*(uint16_t*)BDA_BASE_MEM) * 1024;
+
+    if(ebda != 0 && (fp = mp_search(ebda, 1024)) != NULL){
+        return fp;
+    }
+    if(base_mem >= 1024 && (fp = mp_search(base_mem - 1024, 1024)) != NULL){
+        return fp;
+    }
+    return mp_search(BIOS_ROM_START, BIOS_ROM_END - BIOS_ROM_START);
+}
+
+/* cpu_add(int idx, uint8_t apic_id)
+ * Inputs: idx - index into cpus[], 0 for the boot processor
+ *         apic_id - its local APIC ID
+ * Outputs: none
+ * Side Effects: sets up the entry and apic_cpu
+ */
+static void cpu_add(int idx, uint8_t apic_id){
+    cpus[idx].index = idx;
+    cpus[idx].apic_id = apic_id;
+    cpus[idx].bsp = (idx == 0);
+    cpus[idx].online = (idx == 0);
+    apic_cpu[apic_id] = idx;
+}
+
+/* mp_parse(mp_config_t* conf)
+ * Fills in cpus[] from the processor entries of the MP configuration table, the boot processor
+ * first wherever it is listed
+ * Inputs: conf - the configuration table
+ * Outputs: none
+ * Side Effects: sets lapic_base, num_cpus and apic_cpu
+ */
+static void mp_parse(mp_config_t* conf){
+    uint8_t* entry = (uint8_t*)(conf + 1);
+    mp_cpu_t* cpu;
+    int i, idx;
+
+    lapic_base = conf->lapic_addr;
+    num_cpus = 1;
+
+    for(i = 0; i < conf->entry_count; i++){
+        if(*entry != MP_ENTRY_CPU){
+            entry += MP_OTHER_SIZE;
+            continue;
+        }
+
+        cpu = (mp_cpu_t*)entry;
+        if(cpu->flags & MP_CPU_BSP){
+            idx = 0;
+        }
+        else if((cpu->flags & MP_CPU_ENABLED) && num_cpus < SMP_MAX_CPUS){
+            idx = num_cpus++;
+        }
+        else{
+            idx = -1;
+        }
+
+        if(idx >= 0){
+            cpu_add(idx, cpu->apic_id);
+        }
+        entry += MP_CPU_SIZE;
+    }
+}
+
+/* acpi_search(uint32_t start, uint32_t len)
+ * Looks for the ACPI root system description pointer, which is always 16 byte aligned
+ * Inputs: start - physical address to start at
+ *         len - bytes to search
+ * Outputs: the pointer structure, NULL if it isn't in the range
+ * Side Effects: none
+ */
+static acpi_rsdp_t* acpi_search(uint32_t start, uint32_t len){
+    acpi_rsdp_t* rsdp;
+    uint32_t addr;
+
+    for(addr = start; addr + sizeof(acpi_rsdp_t) <= start + len; addr += 16){
+        rsdp = (acpi_rsdp_t*)addr;
+        if(rsdp->signature[0] == ACPI_RSDP_SIG_LO && rsdp->signature[1] == ACPI_RSDP_SIG_HI &&
+           mp_checksum(rsdp, sizeof(acpi_rsdp_t)) == 0){
+            return rsdp;
+        }
+    }
+    return NULL;
+}
+
+/* madt_find()
+ * Follows the RSDP to the RSDT and looks through it for the MADT - for machines whose firmware only
+ * describes the processors through ACPI. The MP table is tried first since every board we boot on
+ * (QEMU's included) has one, and the RSDT is all that is needed to get at the MADT
+ * Inputs: none
+ * Outputs: the MADT, NULL if there is no (valid) one
+ * Side Effects: reads the ACPI tables by physical address, so paging must still be off
+ */
+static acpi_madt_t* madt_find(void){
+    acpi_rsdp_t* rsdp;
+    acpi_header_t* rsdt;
+    acpi_header_t* table;
+    uint32_t* entries;
+    uint32_t ebda = (uint32_t)(*(uint16_t*)BDA_EBDA_SEG) << 4;
+    uint32_t i, n;
+
+    rsdp = (ebda != 0) ? acpi_search(ebda, 1024) : NULL;
+    if(rsdp == NULL){
+        rsdp = acpi_search(ACPI_RSDP_ROM_START, BIOS_ROM_END - ACPI_RSDP_ROM_START);
+    }
+    if(rsdp == NULL || rsdp->rsdt == 0){
+        return NULL;
+    }
+
+    rsdt = (acpi_header_t*)rsdp->rsdt;
+    if(rsdt->signature != ACPI_RSDT_SIG || rsdt->length < sizeof(acpi_header_t) || mp_checksum(rsdt, rsdt->length) != 0){
+        return NULL;
+    }
+
+    // the RSDT's body is an array of physical addresses of the other tables
+    entries = (uint32_t*)(rsdt + 1);
+    n = (rsdt->length - sizeof(acpi_header_t)) / sizeof(uint32_t);
+    for(i = 0; i < n; i++){
+        table = (acpi_header_t*)entries[i];
+        if(table != NULL && table->signature == ACPI_MADT_SIG && table->length >= sizeof(acpi_madt_t) &&
+           mp_checksum(table, table->length) == 0){
+            return (acpi_madt_t*)table;
+        }
+    }
+    return NULL;
+}
+
+/* madt_parse(acpi_madt_t* madt)
+ * Fills in cpus[] from the local APIC entries of the MADT. It doesn't say which processor is the boot
+ * processor, so that is whoever's local APIC ID matches ours
+ * Inputs: madt - the table
+ * Outputs: none
+ * Side Effects: sets lapic_base, num_cpus and apic_cpu
+ */
+static void madt_parse(acpi_madt_t* madt){
+    uint8_t* entry = (uint8_t*)(madt + 1);
+    uint8_t* end = (uint8_t*)madt + madt->header.length;
+    madt_lapic_t* cpu;
+    uint8_t bsp_id;
+    int idx;
+
+    lapic_base = madt->lapic_addr;
+    bsp_id = lapic_read(LAPIC_ID) >> 24;
+    num_cpus = 1;
+
+    // every entry starts with its type and length, a length of 0 would be a broken table
+    while(entry + 2 <= end && entry[1] != 0 && entry + entry[1] <= end){
+        cpu = (madt_lapic_t*)entry;
+        entry += cpu->length;
+        if(cpu->type != MADT_ENTRY_LAPIC || cpu->length < sizeof(madt_lapic_t) || !(cpu->flags & MADT_LAPIC_ENABLED)){
+            continue;
+        }
+
+        if(cpu->apic_id == bsp_id){
+            idx = 0;
+        }
+        else if(num_cpus < SMP_MAX_CPUS){
+            idx = num_cpus++;
+        }
+        else{
+            continue;
+        }
+        cpu_add(idx, cpu->apic_id);
+    }
+}
+
+/* start_ap(int idx)
+ * Wakes up an application processor with the INIT-SIPI-SIPI sequence from the MP spec (appendix B.4)
+ * Inputs: idx - index into cpus[]
+ * Outputs: none
+ * Side Effects: waits up to 100ms for the processor to show up in ap_main
+ */
+static void start_ap(int idx){
+    int i;
+
+    ap_boot_stack = (uint32_t)ap_stacks[idx] + AP_STACK_SIZE;
+
+    lapic_write(LAPIC_ESR, 0);
+    lapic_ipi(cpus[idx].apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+    pit_wait(PIT_FREQ / 100);                           // 10ms
+    lapic_ipi(cpus[idx].apic_id, ICR_INIT | ICR_LEVEL);   // deassert, older APICs need it
+
+    // the vector is the page number of the startup code, send it twice in case the first one is missed
+    for(i = 0; i < 2; i++){
+        lapic_ipi(cpus[idx].apic_id, ICR_STARTUP | (AP_BOOT_ADDR >> 12));
+        pit_wait(PIT_FREQ / 5000);                      // 200us
+    }
+
+    for(i = 0; i < 10 && !cpus[idx].online; i++){
+        pit_wait(PIT_FREQ / 100);
+    }
+}
+
+/* smp_init()
+ * Finds the processors listed in the MP table, or the ACPI MADT if there is none, and starts all of them
+ * but the one we are running on
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: the application processors check in and wait for the scheduler (see ap_main) - call with
+ *               interrupts off and paging still disabled, the trampoline and MP tables live in low memory
+ */
+void smp_init(void){
+    mp_fp_t* fp;
+    acpi_madt_t* madt;
+    int i;
+
+    num_cpus = 1;
+    cpus_online = 1;
+    lapic_base = 0;
+    cpus[0].bsp = 1;
+    cpus[0].online = 1;
+    cpus[0].active = 1;
+    smp_go = 0;
+
+    fp = mp_find();
+    if(fp != NULL && fp->config != 0 && fp->feature1 == 0 &&
+       ((mp_config_t*)fp->config)->signature == MP_CONFIG_SIG &&
+       mp_checksum((void*)fp->config, ((mp_config_t*)fp->config)->length) == 0){
+        mp_parse((mp_config_t*)fp->config);
+    }
+    else if((madt = madt_find()) != NULL){
+        madt_parse(madt);
+    }
+    else{
+        // no table (or only one of the MP default configurations) - run on the boot processor alone
+        return;
+    }
+
+    if(num_cpus <= 1){
+        return;
+    }
+
+    // the startup IPI can only point below 1MB, so the real mode part goes there
+    memcpy((void*)AP_BOOT_ADDR, ap_trampoline, ap_trampoline_end - ap_trampoline);
+    memcpy((void*)(AP_BOOT_ADDR + (ap_trampoline_gdtr - ap_trampoline)), &gdt_desc, 6);
+
+    // software enable our own APIC so it can send IPIs
+    lapic_enable();
+
+    for(i = 1; i < num_cpus; i++){
+        start_ap(i);
+    }
+}
+
+/* cpu_tss_init(int idx, uint32_t esp0)
+ * Builds the GDT descriptor of a processor's TSS and loads it into the task register - which is also
+ * how this_cpu() tells the processors apart
+ * Inputs: idx - index into cpus[] of the processor calling it
+ *         esp0 - kernel stack to switch to on an interrupt from user space, until the scheduler sets it
+ * Outputs: none
+ * Side Effects: the boot processor's goes into KERNEL_TSS, cpus[idx]'s into AP_TSS + 8 * (idx - 1)
+ */
+void cpu_tss_init(int idx, uint32_t esp0){
+    cpu_t* cpu = &cpus[idx];
+    seg_desc_t the_tss_desc;
+
+    the_tss_desc.granularity   = 0x0;
+    the_tss_desc.opsize        = 0x0;
+    the_tss_desc.reserved      = 0x0;
+    the_tss_desc.avail         = 0x0;
+    the_tss_desc.present       = 0x1;
+    the_tss_desc.dpl           = 0x0;
+    the_tss_desc.sys           = 0x0;
+    the_tss_desc.type          = 0x9;
+    SET_TSS_PARAMS(the_tss_desc, &cpu->tss, TSS_SIZE - 1);
+
+    if(idx == 0){
+        tss_desc_ptr = the_tss_desc;
+    }
+    else{
+        ap_tss_desc_ptr[idx - 1] = the_tss_desc;
+    }
+
+    cpu->index = idx;
+    cpu->sysenter_tss = &cpu->tss;
+    cpu->tss.ldt_segment_selector = KERNEL_LDT;
+    cpu->tss.ss0 = KERNEL_DS;
+    cpu->tss.esp0 = esp0;
+    ltr((idx == 0) ? KERNEL_TSS : AP_TSS + 8 * (idx - 1));
+}
+
+/* kernel_lock()
+ * Takes the big kernel lock, or nests once more if this processor already holds it. Only one processor
+ * runs kernel code at a time, so the kernel's globals (pcb_table, the terminals, the wait queues, ...)
+ * need nothing more - the run queues have their own spinlock on top since idle processors look at them
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: spins until the lock is free, call with interrupts off
+ */
+void kernel_lock(void){
+    cpu_t* cpu = this_cpu();
+
+    if(cpu->lock_depth == 0){
+        spin_lock(&kernel_big_lock);
+    }
+    cpu->lock_depth++;
+}
+
+/* kernel_unlock()
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: lets go of the lock once the outermost kernel_lock is undone, call with interrupts off
+ */
+void kernel_unlock(void){
+    cpu_t* cpu = this_cpu();
+
+    if(cpu->lock_depth > 0 && --cpu->lock_depth == 0){
+        spin_unlock(&kernel_big_lock);
+    }
+}
+
+/* kernel_lock_drop()
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: the processor doesn't hold the lock afterwards, however often it took it - call with interrupts off
+ */
+void kernel_lock_drop(void){
+    cpu_t* cpu = this_cpu();
+
+    if(cpu->lock_depth > 0){
+        cpu->lock_depth = 0;
+        spin_unlock(&kernel_big_lock);
+    }
+}
+
+/* smp_resched(int idx)
+ * Interrupts another processor so it looks at its run queue and the screen again
+ * Inputs: idx - index into cpus[] of an active processor
+ * Outputs: none
+ * Side Effects: resched_handler runs there once it takes the kernel lock
+ */
+void smp_resched(int idx){
+    lapic_ipi(cpus[idx].apic_id, ICR_FIXED | LAPIC_RESCHED_VEC);
+}
+
+/* smp_resched_others()
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: sends the reschedule IPI to every active processor but this one
+ */
+void smp_resched_others(void){
+    int self = this_cpu()->index;
+    int i;
+
+    for(i = 0; i < num_cpus; i++){
+        if(i != self && cpus[i].active){
+            smp_resched(i);
+        }
+    }
+}
+
+/* ap_main()
+ * Where application processors end up once they are in protected mode. They report in and wait
+ * until the scheduler can use them (smp_go, set once the root shells are running and only if the
+ * local APIC timer is the clock - with the PIT only the boot processor gets timer interrupts), then
+ * set up their own TSS, page directory, APIC and timer and become their idle task.
+ * Inputs: none
+ * Outputs: never returns
+ * Side Effects: marks the processor online, and active once tasks can be queued on it
+ */
+void ap_main(void){
+    int idx = apic_cpu[lapic_read(LAPIC_ID) >> 24];
+    cpu_t* cpu = &cpus[idx];
+    context_t boot_ctx;
+
+    cpu->online = 1;
+    cpus_online++;      // the boot processor starts one AP at a time, so this doesn't race
+
+    // interrupts stay off - nothing is set up for them yet
+    while(!smp_go){
+        asm volatile("pause" ::: "memory");
+    }
+
+    asm volatile("lidt (%0)" : : "r"(&idt_desc_ptr) : "memory");
+    cpu_tss_init(idx, (uint32_t)ap_stacks[idx] + AP_STACK_SIZE);
+    lldt(KERNEL_LDT);
+
+    // the task register is loaded, so this_cpu() works from here on
+    kernel_lock();
+
+    init_paging_ap(idx);
+    lapic_enable();
+    lapic_write(LAPIC_LVT_LINT0, LVT_MASKED);      // the 8259 is wired to the boot processor only
+    sysenter_init_cpu();
+
+    sched_init_cpu(idx);
+    curr_pid = IDLE_PID;
+    scheduled_process = 0;
+    need_resched = 0;
+    timer_start_cpu();
+    cpu->active = 1;
+
+    // the idle task lets go of the kernel lock and takes work as it is queued here, or from the other processors
+    switch_to(&boot_ctx, &cpu->idle->ctx);
+}
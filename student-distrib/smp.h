@@ -0,0 +1,227 @@
+/* smp.h - Multiprocessor discovery and application processor startup
+ */
+
+#ifndef _SMP_H
+#define _SMP_H
+
+#include "types.h"
+#include "lapic.h"
+
+#define SMP_MAX_CPUS        8
+#define SMP_MAX_APIC_ID     256         // APIC IDs are 8 bits
+#define AP_BOOT_ADDR        0x7000      // real mode trampoline is copied here (SIPI vector 0x07), below GRUB's old stage2
+#define AP_STACK_SIZE       4096
+#define SYSENTER_STACK_SIZE 16          // words - only ever used by an NMI that hits before SYSENTER_ENTRY's first instruction
+
+// MP floating pointer structure (Intel MP spec 1.4, section 4.1)
+#define MP_FP_SIG           0x5F504D5F  // "_MP_"
+#define MP_CONFIG_SIG       0x504D4350  // "PCMP"
+#define MP_ENTRY_CPU        0           // processor entries are 20 bytes, every other entry type 8
+#define MP_CPU_SIZE         20
+#define MP_OTHER_SIZE       8
+#define MP_CPU_ENABLED      0x01
+#define MP_CPU_BSP          0x02
+
+#define BDA_EBDA_SEG        0x40E       // BIOS data area: segment of the extended BIOS data area
+#define BDA_BASE_MEM        0x413       // BIOS data area: KB of base memory
+#define BIOS_ROM_START      0xF0000
+#define BIOS_ROM_END        0x100000
+
+// ACPI (spec 6.x, 5.2.5 - 5.2.12) - its MADT lists the processors on machines that have no MP table
+#define ACPI_RSDP_SIG_LO    0x20445352  // "RSD "
+#define ACPI_RSDP_SIG_HI    0x20525450  // "PTR "
+#define ACPI_RSDT_SIG       0x54445352  // "RSDT"
+#define ACPI_MADT_SIG       0x43495041  // "APIC"
+#define ACPI_RSDP_ROM_START 0xE0000     // the RSDP is in the first KB of the EBDA or in 0xE0000 - 0xFFFFF
+#define MADT_ENTRY_LAPIC    0
+#define MADT_LAPIC_ENABLED  0x01
+
+#ifndef ASM
+
+#include "ktimer.h"
+#include "x86_desc.h"
+#include "paging.h"
+#include "schedule.h"
+
+typedef struct __attribute__((packed)) mp_fp {
+    uint32_t signature;         // "_MP_"
+    uint32_t config;            // physical address of the configuration table, 0 if a default config is used
+    uint8_t length;             // in 16 byte units (1)
+    uint8_t spec_rev;
+    uint8_t checksum;           // all bytes add up to 0
+    uint8_t feature1;           // non-zero: default configuration number, no table
+    uint8_t feature2;
+    uint8_t feature3[3];
+} mp_fp_t;
+
+typedef struct __attribute__((packed)) mp_config {
+    uint32_t signature;         // "PCMP"
+    uint16_t length;            // of the base table, header included
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t oem_id[8];
+    uint8_t product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_length;
+    uint16_t entry_count;
+    uint32_t lapic_addr;        // where every CPU sees its local APIC
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+} mp_config_t;
+
+typedef struct __attribute__((packed)) mp_cpu {
+    uint8_t type;               // MP_ENTRY_CPU
+    uint8_t apic_id;
+    uint8_t apic_version;
+    uint8_t flags;              // MP_CPU_ENABLED, MP_CPU_BSP
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+} mp_cpu_t;
+
+typedef struct __attribute__((packed)) acpi_rsdp {
+    uint32_t signature[2];      // "RSD PTR "
+    uint8_t checksum;           // of these 20 bytes (the ACPI 2.0 fields after them have their own)
+    uint8_t oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt;              // physical address of the root system description table
+} acpi_rsdp_t;
+
+// every ACPI table starts with this
+typedef struct __attribute__((packed)) acpi_header {
+    uint32_t signature;
+    uint32_t length;            // of the whole table, header included
+    uint8_t revision;
+    uint8_t checksum;           // all bytes of the table add up to 0
+    uint8_t oem_id[6];
+    uint8_t oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} acpi_header_t;
+
+// multiple APIC description table - followed by variable length entries up to header.length
+typedef struct __attribute__((packed)) acpi_madt {
+    acpi_header_t header;       // "APIC"
+    uint32_t lapic_addr;
+    uint32_t flags;
+} acpi_madt_t;
+
+typedef struct __attribute__((packed)) madt_lapic {
+    uint8_t type;               // MADT_ENTRY_LAPIC
+    uint8_t length;             // of this entry, every entry type starts with these two
+    uint8_t acpi_id;
+    uint8_t apic_id;
+    uint32_t flags;             // MADT_LAPIC_ENABLED
+} madt_lapic_t;
+
+// one per processor found in the MP table (or the MADT) - the boot processor is always cpus[0]
+typedef struct cpu {
+    int index;                  // in cpus[]
+    uint8_t apic_id;
+    uint8_t bsp;                // the processor the kernel booted on
+    volatile int online;        // set by the processor itself once it runs kernel code
+    volatile int active;        // set once it runs the scheduler - tasks are only queued on or moved to active processors
+
+    // what runs on it - curr_pid, scheduled_process, need_resched and idle_task are these fields of this_cpu()
+    int pid;                    // pid of the running task, IDLE_PID in the idle task
+    int term;                   // terminal of the running task
+    volatile int resched;       // set when a task that should run before the running one was woken
+    struct pcb* idle;           // its idle task
+    run_queue_t rq;             // tasks waiting for this processor
+    int lock_depth;             // how many times it has taken the kernel lock, 0 if it doesn't hold it
+
+    // the TSS its task register points at (GDT slot KERNEL_TSS for the boot processor, AP_TSS + 8 * (index - 1) otherwise),
+    // with esp0 at the kernel stack of the running task
+    tss_t tss;
+    pde_t* page_dir;            // its page directory - the kernel half is the same everywhere, 128MB - 140MB is the running task's
+    pte_t* vidmap_pt;           // the page table at 132MB: the running task's vidmap page and the time page
+    uint64_t switch_start_tsc;  // when the switch in progress began
+
+    // SYSENTER_ESP points at sysenter_tss, which SYSENTER_ENTRY follows to tss.esp0 - the stack below it is for an NMI
+    // that comes in before that, so the two have to stay together and in this order
+    uint32_t sysenter_stack[SYSENTER_STACK_SIZE];
+    tss_t* sysenter_tss;
+
+    // scheduler clock - every processor runs its own timer, only the calibration (tick_us) is shared
+    volatile uint32_t ticks;    // scheduler ticks on this processor - in tickless mode caught up from the one-shot length
+    uint32_t tick_residual;     // timer counts that have passed but don't add up to a whole tick yet
+    uint32_t armed_count;       // counts loaded for the pending one-shot, 0 if the timer is stopped
+    int tickless;               // 1 while the timer is in one-shot mode, 0 while it ticks periodically
+    uint32_t tick_deadline;     // earliest tick somebody needs a timer interrupt at, TICK_NO_DEADLINE if none
+    ktimer_wheel_t timers;      // kernel timers armed on this processor
+    uint32_t mlfq_last_tick;    // tick when the running task was last charged
+    uint32_t mlfq_next_boost;   // tick of the next priority boost
+
+    // idle accounting in TSC cycles: total, and for the last full timer period
+    uint64_t idle_cycles;
+    uint64_t idle_start_tsc;    // when the current hlt began, 0 if not halted
+    uint64_t period_start_tsc;  // when the current timer period began
+    uint64_t period_start_idle; // idle_cycles at that point
+    uint32_t period_cycles;     // length of the last timer period
+    uint32_t period_idle_cycles;    // how much of it was spent halted in the idle task
+} cpu_t;
+
+cpu_t cpus[SMP_MAX_CPUS];
+int num_cpus;                   // processors in the MP table (1 if there is none)
+volatile int cpus_online;       // processors that made it into the kernel, the BSP included
+
+// index into cpus[] by local APIC ID
+uint8_t apic_cpu[SMP_MAX_APIC_ID];
+
+// set once the root shells are up, when the scheduler can hand work to the application processors
+volatile int smp_go;
+
+/* this_cpu()
+ * Finds the per processor data of whoever calls it from the TSS its task register points at - every
+ * processor loads its own, and str is much cheaper than reading the local APIC ID, which matters since
+ * this runs on every kernel entry (kernel_lock)
+ * Inputs: none
+ * Outputs: its cpus[] entry
+ * Side Effects: before the boot processor loads its TSS the task register is 0, which is cpus[0] as well
+ */
+static inline cpu_t* this_cpu(void){
+    uint32_t sel;
+
+    asm volatile("str %0" : "=r"(sel));
+    sel &= 0xFFFF;
+    return &cpus[(sel < AP_TSS) ? 0 : (sel - AP_TSS) / 8 + 1];
+}
+
+// finds the other processors and starts them - call before paging is turned on
+void smp_init(void);
+
+// fills in a processor's TSS and its GDT descriptor, and loads its task register
+void cpu_tss_init(int idx, uint32_t esp0);
+
+// the big kernel lock: held while any processor runs kernel code, taken by every interrupt, exception and system call
+// on the way in and dropped on the way out. It nests, and it stays with the processor across a task switch.
+// This is an interim design: user code runs in parallel on every processor, but kernel code - the scheduler
+// included - runs on one at a time, so kernel heavy workloads don't scale yet. The run queue spinlocks are what
+// the scheduler will need once subsystems get locks of their own and the big lock can be narrowed down
+void kernel_lock(void);
+void kernel_unlock(void);
+
+// lets go of the kernel lock however deep it is held, for paths that leave the kernel without going back through
+// the linkage that took it (execute's iret to user space, the idle task)
+void kernel_lock_drop(void);
+
+// sends the reschedule IPI to cpus[idx], or to every other active processor
+void smp_resched(int idx);
+void smp_resched_others(void);
+
+// C entry point of an application processor (called from ap_boot.S)
+void ap_main(void);
+
+// real mode startup code in ap_boot.S, copied to AP_BOOT_ADDR
+extern uint8_t ap_trampoline[];
+extern uint8_t ap_trampoline_gdtr[];
+extern uint8_t ap_trampoline_end[];
+
+// stack the application processor being started sets up in ap_boot.S
+uint32_t ap_boot_stack;
+
+#endif /* ASM */
+
+#endif /* _SMP_H */
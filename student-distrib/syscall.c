@@ -2,12 +2,12 @@
 #include "syscall.h"
 
 // initialize the file operations table 
-fops_t std_in_table = { bad_open, terminal_read, bad_write, bad_close};
-fops_t std_out_table = {bad_open, bad_read, terminal_write, bad_close};
-fops_t rtc_table = {rtc_open, rtc_read, rtc_write, rtc_close};
-fops_t filesys_table = {file_open, file_read, file_write, file_close};
-fops_t filedir_table = {dir_open, dir_read, dir_write, dir_close};
-fops_t bad_table = {bad_open, bad_read, bad_write, bad_close};
+fops_t std_in_table = { bad_open, terminal_read, bad_write, bad_close, NULL, NULL};
+fops_t std_out_table = {bad_open, bad_read, terminal_write, bad_close, NULL, terminal_writev};
+fops_t rtc_table = {rtc_open, rtc_read, rtc_write, rtc_close, NULL, NULL};
+fops_t filesys_table = {file_open, file_read, file_write, file_close, NULL, NULL};
+fops_t filedir_table = {dir_open, dir_read, dir_write, dir_close, NULL, NULL};
+fops_t bad_table = {bad_open, bad_read, bad_write, bad_close, NULL, NULL};
 
 /* local variables */
 // static int pid_array[MAX_NUM_PIDS];
@@ -26,16 +26,53 @@ void handle_system_call(){
     while(1);
 }
 
+/* sysenter_init() - checks whether the CPU has sysenter, and sets it up on the boot processor if it does
+ * Inputs: None
+ * Outputs: None
+ * Side Effects: tells programs through the time page, so their system call stubs use sysenter instead of int 0x80.
+ *               The GDT already has the layout sysexit wants: USER_CS = KERNEL_CS + 16, USER_DS = KERNEL_CS + 24
+ */
+static void sysenter_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    // the Pentium Pro sets SEP without having sysenter (family 6, model and stepping below 3)
+    if (!(edx & CPUID_FEAT_SEP) || (((eax >> 8) & 0xF) == 6 && ((eax >> 4) & 0xF) < 3 && (eax & 0xF) < 3)) {
+        return;
+    }
+
+    time_page->sysenter = 1;
+    sysenter_init_cpu();
+}
+
+/* sysenter_init_cpu() - points the sysenter MSRs of the processor calling it at SYSENTER_ENTRY
+ * Inputs: None
+ * Outputs: None
+ * Side Effects: none if sysenter_init didn't find sysenter - the processors of one machine all have it or none does.
+ *               SYSENTER_ESP is the processor's own cpu->sysenter_tss, which SYSENTER_ENTRY follows to its TSS
+ */
+void sysenter_init_cpu(void) {
+    if (!time_page->sysenter) {
+        return;
+    }
+
+    asm volatile("wrmsr" : : "c"(MSR_SYSENTER_CS), "a"(KERNEL_CS), "d"(0));
+    asm volatile("wrmsr" : : "c"(MSR_SYSENTER_ESP), "a"((uint32_t)&this_cpu()->sysenter_tss), "d"(0));
+    asm volatile("wrmsr" : : "c"(MSR_SYSENTER_EIP), "a"((uint32_t)SYSENTER_ENTRY), "d"(0));
+}
+
 /* void syscall_init() - set up structures and local variables used in passing in parameters for system calls
  * Inputs: None
  * Outputs: None
- * Side Effects: initializes pid_array to unused for all entries
+ * Side Effects: every pid is free, sysenter is set up - runs after clock_init, which sets up the time page
  */
 void syscall_init() {
     int i;
     for (i = 0; i < MAX_NUM_PIDS; i++) {
-        pid_array[i] = UNUSED;
+        pcb_table[i] = NULL;
     }
+    pid_init();
+    sysenter_init();
 }
 
 
@@ -64,13 +101,14 @@ int32_t sys_halt (uint8_t status){
     // CHECK IF HALTING SHELL (hints doc thingy)
     // if it is the first shell, just return -1 => literally use like an if statement
     /*
-    if (curr_pcb->curr_pid == 0) {
+    if (curr_pcb->pid == 0) {
         return -1;
     }
     */
 
     // Set pids to unused
-    pid_array[curr_pcb->curr_pid] = NOT_IN_USE;
+    pcb_table[curr_pcb->pid] = NULL;
+    pid_free(curr_pcb->pid);
 
     int i;
     // close any relevant FDs
@@ -80,6 +118,22 @@ int32_t sys_halt (uint8_t status){
         sys_close(i);
     }
 
+    // give the program's frames back - unmapped first, so no stale TLB entry can reach them once they are reused
+    unmap_user_program();
+    user_pt_destroy(curr_pcb->user_page_table);
+    curr_pcb->user_page_table = NULL;
+    kfree(curr_pcb->exe_segs);
+    curr_pcb->exe_segs = NULL;
+    user_pt_destroy(curr_pcb->mmap_page_table);     // image blocks stay, only the io ring page is the program's
+    curr_pcb->mmap_page_table = NULL;
+    curr_pcb->ioring = NULL;
+    ktimer_del(&curr_pcb->sleep_timer);
+    kfree(curr_pcb->sc_stats);          // the parent is the one that returns through the linkage, so nothing touches it anymore
+    curr_pcb->sc_stats = NULL;
+
+    // the kernel stack (and the pcb on it) is only reclaimed once we have jumped off it, so curr_pcb stays usable below
+    kstack_free((uint32_t)curr_pcb);
+
     // if first shell, restart a new one
     // original was curr_pid == 0
     if(curr_pid <= 2){
@@ -91,21 +145,35 @@ int32_t sys_halt (uint8_t status){
     
     // restore tss values and EBP/ESP values
     // tss.esp0 = curr_pcb->old_esp;
-    tss.esp0 = 0x800000 - (curr_pcb->parent_pid) * 0x2000;      // 8MB - (pid)*8kB
+    // the parent takes over on this processor, whichever one it was running on when it called execute
+    this_cpu()->tss.esp0 = get_pcb_from_pid(curr_pcb->parent_pid)->base_kernel_stack;
     // tss.esp0 = curr_pcb->old_esp0;
-    tss.ss0 = KERNEL_DS;        // unsure if this is needed? halt worked fine without
+    this_cpu()->tss.ss0 = KERNEL_DS;        // unsure if this is needed? halt worked fine without
 
      // restore parent paging
     // pcb_t* parent_pcb = curr_pcb->parent_pcb;
-    map_user_program(curr_pcb->parent_pid);
+    map_user_program(get_pcb_from_pid(curr_pcb->parent_pid)->user_page_table, get_pcb_from_pid(curr_pcb->parent_pid)->mmap_page_table);
 
     /* Update terminal and pcb's active pid to other settings*/
     terminals[curr_pcb->term_id].active_pid = curr_pcb->parent_pid;
-    scheduling_array[curr_pcb->term_id] = curr_pcb->parent_pid;
+    curr_pcb->state = TASK_DEAD;
 
-    // restore pcb
+    // restore pcb - the parent was blocked in execute and takes over as the running task
     curr_pid = curr_pcb->parent_pid;
     curr_pcb = get_pcb_from_pid(curr_pid);
+    curr_pcb->state = TASK_RUNNABLE;
+    curr_pcb->cpu = this_cpu()->index;
+    acct_start(curr_pcb);
+
+    // the child may have moved to another processor than the one the parent ran on - whatever this one has cached of the parent is old
+    if(curr_pcb->last_cpu != curr_pcb->cpu){
+        curr_pcb->last_cpu = curr_pcb->cpu;
+        flush_tlb();
+    }
+
+    // the parent comes back out of the system call linkage that took the kernel lock for its execute - that is
+    // the one level it holds, whatever entry (system call, exception, keyboard) got us here
+    this_cpu()->lock_depth = 1;
 
     // // indicate the process no longer running
     // running_flag = 0;
@@ -195,41 +263,89 @@ int32_t sys_execute (const uint8_t* command){
     }
 
     // read header (found at start of ELF file)
-    uint8_t read_buf[4];                               // only need 4 because of the magic numbers
+    elf_header_t ehdr;
+    elf_phdr_t phdrs[ELF_MAX_PHDRS];
     uint32_t inode_idx = d.inode_num;                   // get inode from read_dentry
-    read_data(inode_idx, 0, read_buf, 4);               // again, only 4 magic numbers, read into read_buf
+    if(read_data(inode_idx, 0, (uint8_t*)&ehdr, sizeof(ehdr)) != sizeof(ehdr)){
+        return -1;
+    }
 
     // now check if executable file
-    // magic numbers from https://wiki.osdev.org/ELF (0x7F, E, L, F) -> bits 0 to 3
-    if(read_buf[0] != 0x7F || read_buf[1] != 'E' || read_buf[2] != 'L' || read_buf[3] != 'F'){
+    // magic numbers from https://wiki.osdev.org/ELF (0x7F, E, L, F) -> bytes 0 to 3
+    if(ehdr.magic != ELF_MAGIC){
         return -1;      // return -1 since magic numbers dont match what ELF should be
     }
 
-    // now obtain program entry position (bits 24-27) - also 4 bits so we can overwrite read_buf
-    // offset should be 6 since we need to start looking at 24 bytes (we originally start from 0)
-    // the offset is a uint32_t, so there are 4 bytes per (24/4 => 6)
-    read_data(inode_idx, 24, read_buf, 4);              // read 4 bc only 4 bits to read
-    uint32_t entry_position = (uint32_t)(read_buf[3] << 24 | read_buf[2] << 16 | read_buf[1] << 8 | read_buf[0]); // shell gives 0x080495c0 (still wrong)
-    
-    //uint32_t entry_position = (uint32_t)read_buf;     // make this a uint32_t pointer -> shell gives 0x7ffe24 (def wrong)
-    // uint32_t entry_position = *((uint32_t*)read_buf); // shell gives 0x080495c0
-    //uint32_t entry_position = 0x080482e8;     // -> correct value according to hex editor
+    // program headers say which parts of the file go where - the program only gets frames for those, plus a stack
+    if(ehdr.phnum == 0 || ehdr.phnum > ELF_MAX_PHDRS || ehdr.phentsize != sizeof(elf_phdr_t)){
+        return -1;
+    }
+    if(read_data(inode_idx, ehdr.phoff, (uint8_t*)phdrs, ehdr.phnum * sizeof(elf_phdr_t)) != ehdr.phnum * sizeof(elf_phdr_t)){
+        return -1;
+    }
+    for(i = 0; i < ehdr.phnum; i++){
+        if(phdrs[i].type != PT_LOAD){
+            continue;
+        }
+        // every segment has to fit between 128MB and the stack
+        if(phdrs[i].filesz > phdrs[i].memsz || phdrs[i].vaddr < ONE28_MB ||
+           phdrs[i].memsz > USER_STACK_TOP - USER_STACK_PAGES * FOUR_KB - phdrs[i].vaddr ||
+           phdrs[i].vaddr > USER_STACK_TOP - USER_STACK_PAGES * FOUR_KB){
+            return -1;
+        }
+    }
+
+    // program entry position (bytes 24-27)
+    uint32_t entry_position = ehdr.entry;
 
 
     // STEP 3: Paging
 
-    // find an unused pid (0-5)
-    int pid;
-    for (pid = 0; pid < MAX_NUM_PIDS; pid++) {
-        if (pid_array[pid] == UNUSED) {
-            pid_array[pid] = USED;
-            break;
+    // find an unused pid (the lowest one, so the terminals' shells are 0-2) and a kernel stack for it
+    int pid = pid_alloc();
+    if (pid == -1) {
+        return -1;
+    }
+    uint32_t kstack = kstack_alloc();
+    if (kstack == 0) {
+        pid_free(pid);
+        return -1;
+    }
+
+    // the loadable segments are kept for the page fault handler, which reads each page in from the file when it is first touched
+    int nsegs = 0;
+    for(i = 0; i < ehdr.phnum; i++){
+        if(phdrs[i].type == PT_LOAD){
+            phdrs[nsegs++] = phdrs[i];
         }
-        // if pid_array is full
-        if (pid == MAX_NUM_PIDS - 1) {
-            return -1;
+    }
+    elf_phdr_t* segs = kmalloc(nsegs * sizeof(elf_phdr_t));
+
+    // the task's system call table is set up here rather than on its first call, so the syscall entry hook never allocates
+    sysstats_t* sc_stats = kmalloc(sizeof(sysstats_t));
+
+    // page table with every page a segment touches, and the stack, reserved - no frames until they are used
+    pte_t* user_pt = user_pt_create();
+    uint32_t page;
+    if(user_pt == NULL || (segs == NULL && nsegs > 0) || sc_stats == NULL){
+        // out of memory - nothing has been changed yet except the pid
+        kfree(sc_stats);
+        kfree(segs);
+        user_pt_destroy(user_pt);
+        kstack_free(kstack);
+        pid_free(pid);
+        return -1;
+    }
+    for(i = 0; i < nsegs; i++){
+        segs[i] = phdrs[i];
+        for(page = phdrs[i].vaddr & ~(FOUR_KB - 1); page < phdrs[i].vaddr + phdrs[i].memsz; page += FOUR_KB){
+            user_reserve_page(user_pt, page, phdrs[i].flags & PF_W);
         }
     }
+    for(page = USER_STACK_TOP - USER_STACK_PAGES * FOUR_KB; page < USER_STACK_TOP; page += FOUR_KB){
+        user_reserve_page(user_pt, page, 1);
+    }
+
     // if pid = 0, first shell -> tell keyboard
     shell_flag = 1;
 
@@ -238,23 +354,29 @@ int32_t sys_execute (const uint8_t* command){
         running_flag = 1;
     }
 
-    // map user program
-    map_user_program(pid);
-
-    // STEP 4: user level program loader
-    uint8_t* usr_buf = (uint8_t*)0x8048000;                 // memory 
-    uint32_t exe_length = ((inode_t*)(fs_start_addr + (inode_idx + 1) * BLOCK_SIZE))->length;       // get length
-    read_data(inode_idx, 0, usr_buf, exe_length);       // load data into usr_buf
-                                                        // offset of 0 since we want to read in from byte 0 (start of executable)
-    // already have entry position from step 2
-
-    // STEP 5: PCB
+    // STEP 4: PCB
 
     // helper function to make/initialize a PCB
     //pcb_t curr_pcb;
     //init_pcb(&curr_pcb, pid, args);
+    pcb_table[pid] = (pcb_t*)kstack;                // the pcb sits at the bottom of the process' kernel stack
     pcb_t* curr_pcb = init_pcb(pid, args);
     // pcb_t* testing_pcb = get_pcb_ptr();
+    curr_pcb->user_page_table = user_pt;
+    curr_pcb->exe_inode = inode_idx;
+    curr_pcb->exe_segs = segs;
+    curr_pcb->exe_nsegs = nsegs;
+    curr_pcb->mmap_page_table = NULL;
+    curr_pcb->mmap_next = MMAP_BASE;
+    curr_pcb->ioring = NULL;
+    memset(sc_stats, 0, sizeof(sysstats_t));
+    curr_pcb->sc_stats = sc_stats;
+
+    // map user program
+    map_user_program(user_pt, NULL);
+
+    // STEP 5: user level program loader - nothing to copy, the page fault handler loads pages as the program touches them
+    // already have entry position from step 2
 
     /*Initalize term id and update active pid of curr_term*/
     int curr_esp;
@@ -273,12 +395,9 @@ int32_t sys_execute (const uint8_t* command){
     if(pid <= 2){
         curr_pcb->term_id = scheduled_process;
         terminals[scheduled_process].active_pid = pid;
-        scheduling_array[scheduled_process] = pid;
 
-        // shells will never halt -> only important is schedule esp/ebp
-        curr_pcb->old_esp0 = tss.esp0;          // dont think this matters
-        curr_pcb->schedule_esp = curr_esp;
-        curr_pcb->schedule_ebp = curr_ebp;
+        // shells will never halt -> ctx is filled in by switch_to the first time the shell is switched out
+        curr_pcb->old_esp0 = this_cpu()->tss.esp0;          // dont think this matters
 
         curr_pcb->old_ebp = curr_ebp;
         curr_pcb->old_esp = curr_esp;
@@ -286,35 +405,57 @@ int32_t sys_execute (const uint8_t* command){
     }
     // case for normal scheduling
     else{
-        curr_pcb->parent_pid = scheduling_array[curr_term];
-        pcb_t* parent_pcb = get_pcb_from_pid(scheduling_array[curr_term]); // retrieve parent program's pcb
+        // the caller is the parent - it may not be on the terminal being viewed
+        curr_pcb->parent_pid = curr_pid;
+        pcb_t* parent_pcb = get_pcb_from_pid(curr_pid); // retrieve parent program's pcb
         parent_pcb->child_pid = pid;
 
-        curr_pcb->term_id = curr_term;
-        terminals[curr_term].active_pid = pid;
-        scheduling_array[curr_term] = pid;
+        // parent blocks in execute until the child halts, so it stays off the run queue
+        parent_pcb->state = TASK_WAITING;
+
+        curr_pcb->term_id = parent_pcb->term_id;
+        terminals[curr_pcb->term_id].active_pid = pid;
 
-        // scheduling and execute ebp/esp are DIFFERENT
-        curr_pcb->old_esp0 = tss.esp0;      // again this may not matter
-        curr_pcb->schedule_esp = curr_pcb->base_kernel_stack;
-        curr_pcb->schedule_ebp = curr_pcb->schedule_esp;
+        // children of a deprioritized task (a niced shell, ...) start out deprioritized too
+        curr_pcb->base_level = parent_pcb->base_level;
+
+        // scheduling and execute ebp/esp are DIFFERENT - ctx is only filled in once the child is switched out
+        curr_pcb->old_esp0 = this_cpu()->tss.esp0;      // again this may not matter
 
         curr_pcb->old_ebp = curr_ebp;
         curr_pcb->old_esp = curr_esp;
 
     }
 
+    // the caller stops running here until the child halts
+    if(curr_pid != pid){
+        acct_update(get_pcb_from_pid(curr_pid));
+    }
+
     // update current pid
     curr_pid = pid;
+    curr_pcb->cpu = this_cpu()->index;
+    curr_pcb->last_cpu = curr_pcb->cpu;
+
+    // start with a full quantum at the base level (the new task is running, so it isn't queued)
+    mlfq_set_level(curr_pcb, curr_pcb->base_level);
 
     // STEP 6: Context Switch - home stretch ?
     // fucking big brain moves at 2:57am
 
     // prepare for context switch: write new process' info to TSS
-    tss.ss0 = KERNEL_DS;                        // if OSDEV tells you to jump off a cliff, would you do it? of course yes OSDEV legit
-    tss.esp0 = curr_pcb->base_kernel_stack;     // already calculated, fucking genius
+    this_cpu()->tss.ss0 = KERNEL_DS;                        // if OSDEV tells you to jump off a cliff, would you do it? of course yes OSDEV legit
+    this_cpu()->tss.esp0 = curr_pcb->base_kernel_stack;     // already calculated, fucking genius
 
-    // need to do a tss_flush, then enter ring 3 ? -> no tss flush, since only one tss for all processes (for this mp)
+    // need to do a tss_flush, then enter ring 3 ? -> no tss flush, each processor keeps its one TSS and only esp0 changes
+
+    // from here on the child's time is user time
+    acct_update(curr_pcb);
+    curr_pcb->acct_mode = ACCT_USER;
+
+    // the iret below never comes back through the linkage that took the kernel lock, so let go of it here -
+    // interrupts stay off until we are in user space
+    kernel_lock_drop();
 
     /* OSDEV Order
     user data segment
@@ -390,8 +531,8 @@ int32_t sys_read (int32_t fd, void* buf, int32_t nbytes){
     // get pcb_ptr
     curr_pcb = get_pcb_ptr();
 
-    /* Check valid buf input */
-    if (buf == NULL)
+    /* Check valid buf input - the driver writes to it, so it has to be on pages the program may write */
+    if (buf == NULL || bad_userspace_addr(buf, nbytes, 1))
         return -1;
     /* Check if fd index corresponds to valid fd */
     if (curr_pcb->fda[fd].flags == NOT_IN_USE)
@@ -461,6 +602,7 @@ int32_t sys_open (const uint8_t* filename){
     switch (test_dentry.filetype){
         case 0:     //RTC filetype
             fd_entry.fops_ptr = rtc_table;
+            fd_entry.rtc_freq = RTC_DEFAULT_FREQ;
             break;
         case 1:     //Directory filetype
             fd_entry.fops_ptr = filedir_table;
@@ -523,6 +665,7 @@ int32_t sys_getargs (uint8_t* buf, int32_t nbytes){
     if (buf == NULL) return -1;
 
     if (nbytes <= 0) return -1;
+    if (bad_userspace_addr(buf, nbytes, 1)) return -1;
 
     pcb_t *curr_pcb = get_pcb_ptr();
 
@@ -549,7 +692,7 @@ int32_t sys_vidmap (uint8_t** screen_start){
     // just check whether the address falls within the address range covered by the single user-level page
     // NOTE: requires us to add anohter page mapping for the program (4kB page)
     /* Make sure screen_start is within virtual addr range for user-level page (128-132MB) */
-    if(screen_start < (uint8_t**) ONE28_MB || screen_start >= (uint8_t**) ONE32_MB)  return -1;
+    if(bad_userspace_addr(screen_start, sizeof(uint8_t*), 1))  return -1;
     //map_vidmem(screen_start, curr_pid);
     map_vidmem();
 
@@ -559,6 +702,525 @@ int32_t sys_vidmap (uint8_t** screen_start){
 }
 
 
+/* int32_t sys_set_handler (int32_t signum, void* handler_address)
+ * Changes the default action taken when a signal is received
+ * Inputs: int32_t signum - signal to install the handler for
+ *         void* handler_address - user level handler
+ * Outputs: -1, signals are not supported
+ * Side Effects: none
+ */
+int32_t sys_set_handler (int32_t signum, void* handler_address){
+    return -1;
+}
+
+/* int32_t sys_sigreturn (void)
+ * Returns from a user level signal handler
+ * Inputs: none
+ * Outputs: -1, signals are not supported
+ * Side Effects: none
+ */
+int32_t sys_sigreturn (void){
+    return -1;
+}
+
+/* int32_t sys_set_priority (int32_t pid, int32_t level)
+ * Sets the base MLFQ level of a process - batch jobs can be pushed down so they don't get in the way of interactive ones
+ * Inputs: int32_t pid - process to change, -1 for the caller
+ *         int32_t level - 0 (highest, default) to MLFQ_LEVELS - 1 (lowest)
+ * Outputs: -1 if the pid or level is invalid
+ *          0 on success
+ * Side Effects: the process moves to the new level right away with a fresh quantum; programs it executes afterwards inherit the level
+ */
+int32_t sys_set_priority (int32_t pid, int32_t level){
+    pcb_t* task;
+    uint32_t flags;
+
+    if(pid == -1){
+        pid = curr_pid;
+    }
+    if(pid < 0 || pid >= MAX_NUM_PIDS || pcb_table[pid] == NULL){
+        return -1;
+    }
+    if(level < MLFQ_TOP || level > MLFQ_BOTTOM){
+        return -1;
+    }
+
+    cli_and_save(flags);
+    task = get_pcb_from_pid(pid);
+    task->base_level = level;
+    mlfq_set_level(task, level);
+    restore_flags(flags);
+
+    return 0;
+}
+
+/* fill_stats(proc_stats_t* entry, pcb_t* task)
+ * Copies a process' accounting into a getstats entry
+ * Inputs: entry - where to put it
+ *         task - pcb of the process
+ * Outputs: none
+ * Side Effects: brings the running task's counters up to date first
+ */
+static void fill_stats(proc_stats_t* entry, pcb_t* task){
+    if(task_running(task)){
+        acct_update(task);
+    }
+
+    entry->pid = task->pid;
+    entry->term_id = task->term_id;
+    entry->state = task->state;
+    entry->level = task->prio_level;
+    entry->start_tsc = task->start_tsc;
+    entry->user_cycles = task->user_cycles;
+    entry->kernel_cycles = task->kernel_cycles;
+    entry->nr_switches = task->nr_switches;
+    entry->nr_syscalls = task->nr_syscalls;
+    entry->switch_cycles = task->switch_cycles;
+    entry->now_tsc = rdtsc();
+}
+
+/* int32_t sys_getstats (proc_stats_t* buf, int32_t nentries)
+ * Reports the CPU time used by every process, plus the idle task
+ * Inputs: proc_stats_t* buf - user array to fill in
+ *         int32_t nentries - size of the array
+ * Outputs: -1 if the array isn't inside the user page
+ *          number of entries filled in otherwise (the idle task, pid -1, comes first)
+ * Side Effects: none
+ */
+int32_t sys_getstats (proc_stats_t* buf, int32_t nentries){
+    int pid;
+    int32_t count;
+    uint32_t flags;
+
+    /* Make sure the whole array is on pages the program has (128-132MB) */
+    if(nentries <= 0 || nentries > MAX_NUM_PIDS + 1) return -1;
+    if(bad_userspace_addr(buf, nentries * sizeof(proc_stats_t), 1)) return -1;
+
+    cli_and_save(flags);
+    fill_stats(&buf[0], idle_task);
+    count = 1;
+    for(pid = 0; pid < MAX_NUM_PIDS && count < nentries; pid++){
+        if(pcb_table[pid] == NULL){
+            continue;
+        }
+        fill_stats(&buf[count++], get_pcb_from_pid(pid));
+    }
+    restore_flags(flags);
+
+    return count;
+}
+
+/* int32_t sys_clock_gettime (int32_t clock_id, timespec_t* ts)
+ * Reads the monotonic or the wall clock - the same clocks programs can read from the time page without a system call
+ * Inputs: int32_t clock_id - CLOCK_REALTIME or CLOCK_MONOTONIC
+ *         timespec_t* ts - where to put the time
+ * Outputs: -1 if the clock doesn't exist or ts isn't inside the user page, 0 otherwise
+ * Side Effects: none
+ */
+int32_t sys_clock_gettime (int32_t clock_id, timespec_t* ts){
+    uint64_t ns;
+
+    if(clock_id != CLOCK_REALTIME && clock_id != CLOCK_MONOTONIC) return -1;
+    if(bad_userspace_addr(ts, sizeof(timespec_t), 1)) return -1;
+
+    ns = clock_ns(clock_id);
+    ts->tv_nsec = div64_32(&ns, NSEC_PER_SEC);
+    ts->tv_sec = (uint32_t)ns;
+    return 0;
+}
+
+/* sleep_expired(ktimer_t* timer)
+ * Timer function of a task in sleep: wakes it up
+ * Inputs: ktimer_t* timer - the task's sleep_timer
+ * Outputs: none
+ * Side Effects: the task may preempt the running one, like a keypress does
+ */
+static void sleep_expired(ktimer_t* timer){
+    wq_wake_up_preempt(&((pcb_t*)timer->data)->sleep_wq);
+}
+
+/* int32_t sys_sleep (int32_t ms)
+ * Blocks the calling program for at least the given time, without using the CPU or the RTC
+ * Inputs: int32_t ms - milliseconds to sleep, 0 returns right away
+ * Outputs: -1 if ms is negative, 0 once the time has passed
+ * Side Effects: times longer than WHEEL_MAX_TICKS scheduler ticks are cut short
+ */
+int32_t sys_sleep (int32_t ms){
+    pcb_t* curr_pcb = get_pcb_from_pid(curr_pid);
+    uint64_t ticks;
+    uint32_t flags;
+
+    if(ms < 0) return -1;
+    if(ms == 0) return 0;
+
+    // round up, plus one more tick because the current one is already partly over
+    ticks = (uint64_t)ms * 1000 + tick_us - 1;
+    div64_32(&ticks, tick_us);
+    ticks++;
+    if(ticks > WHEEL_MAX_TICKS) ticks = WHEEL_MAX_TICKS;
+
+    cli_and_save(flags);
+    ktimer_add(&curr_pcb->sleep_timer, (uint32_t)ticks);
+    while(ktimer_pending(&curr_pcb->sleep_timer)){
+        wq_sleep(&curr_pcb->sleep_wq);
+    }
+    restore_flags(flags);
+
+    return 0;
+}
+
+/* int32_t sys_kmemstats (kmem_stats_t* buf)
+ * Reports how the kernel heap is doing: bytes in use and held, and the occupancy of every size class - plus how
+ * often the TLB was flushed
+ * Inputs: kmem_stats_t* buf - where to put the statistics
+ * Outputs: -1 if buf isn't on pages the program has, 0 otherwise
+ * Side Effects: none
+ */
+int32_t sys_kmemstats (kmem_stats_t* buf){
+    if(bad_userspace_addr(buf, sizeof(kmem_stats_t), 1)) return -1;
+
+    kmem_get_stats(buf);
+    buf->tlb_full_flushes = tlb_full_flushes;
+    buf->tlb_page_flushes = tlb_page_flushes;
+    return 0;
+}
+
+/* int32_t mmap_region_init (pcb_t* curr_pcb)
+ * Gives the region between 136MB and 140MB its page table, on the first mmap or ioring_setup
+ * Inputs: pcb_t* curr_pcb - the running process
+ * Outputs: -1 if there is no frame for the table, 0 otherwise
+ * Side Effects: maps the table in
+ */
+static int32_t mmap_region_init (pcb_t* curr_pcb){
+    if(curr_pcb->mmap_page_table == NULL){
+        curr_pcb->mmap_page_table = user_pt_create();
+        if(curr_pcb->mmap_page_table == NULL){
+            return -1;
+        }
+        map_user_program(curr_pcb->user_page_table, curr_pcb->mmap_page_table);
+    }
+    return 0;
+}
+
+/* int32_t sys_mmap (int32_t fd, int32_t length)
+ * Maps the start of an open file read-only into the program, straight onto the filesystem image's data blocks -
+ * the blocks of the file follow each other in virtual memory even where they don't in the image
+ * Inputs: int32_t fd - a regular file the program has open
+ *         int32_t length - bytes to map, cut off at the end of the file
+ * Outputs: -1 if fd isn't an open file, the file is empty, length isn't positive or the mmap region is full
+ *          address the file starts at otherwise (between 136MB and 140MB)
+ * Side Effects: the last page is padded with whatever follows the file in its block. Mappings last until the program halts
+ */
+int32_t sys_mmap (int32_t fd, int32_t length){
+    pcb_t* curr_pcb = get_pcb_from_pid(curr_pid);
+    uint32_t inode, offset, block, addr;
+    uint32_t npages;
+
+    if(fd < 0 || fd >= FDA_SIZE || curr_pcb->fda[fd].flags == NOT_IN_USE || curr_pcb->fda[fd].fops_ptr.read != file_read){
+        return -1;
+    }
+    inode = curr_pcb->fda[fd].inode;
+    if(length <= 0 || file_block_addr(inode, 0) == 0){
+        return -1;
+    }
+
+    npages = ((uint32_t)length + FOUR_KB - 1) / FOUR_KB;
+    if(npages > (MMAP_LIMIT - curr_pcb->mmap_next) / FOUR_KB){
+        return -1;
+    }
+
+    if(mmap_region_init(curr_pcb) == -1){
+        return -1;
+    }
+
+    // the entries were not present before, so no TLB entry can be stale
+    addr = curr_pcb->mmap_next;
+    for(offset = 0; offset < (uint32_t)length; offset += FOUR_KB){
+        block = file_block_addr(inode, offset);
+        if(block == 0){
+            break;
+        }
+        user_map_shared(curr_pcb->mmap_page_table, addr + offset, block);
+    }
+    curr_pcb->mmap_next = addr + offset;
+
+    return (int32_t)addr;
+}
+
+/* int32_t sys_ioring_setup (void)
+ * Gives the program a page of submission and completion rings (io_ring_t) in its mmap region. The program queues
+ * read, write, open and close requests in it and hands over any number of them with one ioring_enter
+ * Inputs: none
+ * Outputs: -1 if the mmap region is full or there is no free frame, the address of the page otherwise - the same
+ *          page every time
+ * Side Effects: the page lasts until the program halts
+ */
+int32_t sys_ioring_setup (void){
+    pcb_t* curr_pcb = get_pcb_from_pid(curr_pid);
+    uint32_t addr;
+
+    if(curr_pcb->ioring != NULL){
+        return (int32_t)curr_pcb->ioring;
+    }
+    if(curr_pcb->mmap_next >= MMAP_LIMIT || mmap_region_init(curr_pcb) == -1){
+        return -1;
+    }
+
+    // zeroed, so both rings start out empty at index 0
+    addr = curr_pcb->mmap_next;
+    if(user_map_page(curr_pcb->mmap_page_table, addr, 1) == -1){
+        return -1;
+    }
+    curr_pcb->mmap_next = addr + FOUR_KB;
+    curr_pcb->ioring = (io_ring_t*)addr;
+    curr_pcb->ioring_sq_head = 0;
+    curr_pcb->ioring_cq_tail = 0;
+
+    return (int32_t)addr;
+}
+
+/* int32_t sys_ioring_enter (int32_t to_submit)
+ * Runs queued submissions in order, each through its system call, and posts a completion for each one
+ * Inputs: int32_t to_submit - most submissions to run
+ * Outputs: -1 if the program has no io ring or to_submit is negative, the number of submissions run otherwise
+ * Side Effects: stops early once the completion ring is full - the rest wait for the next enter. A read that blocks
+ *               blocks the whole batch
+ */
+int32_t sys_ioring_enter (int32_t to_submit){
+    pcb_t* curr_pcb = get_pcb_from_pid(curr_pid);
+    io_ring_t* ring = curr_pcb->ioring;
+    io_sqe_t sqe;
+    io_cqe_t* cqe;
+    int32_t done, res;
+
+    if(ring == NULL || to_submit < 0){
+        return -1;
+    }
+
+    for(done = 0; done < to_submit && curr_pcb->ioring_sq_head != ring->sq_tail; done++){
+        if(curr_pcb->ioring_cq_tail - ring->cq_head >= IORING_CQ_ENTRIES){
+            break;
+        }
+
+        // a copy, since the program may change the slot while a call blocks
+        sqe = ring->sqes[curr_pcb->ioring_sq_head++ & (IORING_SQ_ENTRIES - 1)];
+        ring->sq_head = curr_pcb->ioring_sq_head;
+
+        // the calls check the arguments as if the program had made them itself
+        switch(sqe.op){
+            case IORING_OP_NOP:
+                res = 0;
+                break;
+            case IORING_OP_READ:
+                res = sys_read(sqe.fd, (void*)sqe.addr, sqe.len);
+                break;
+            case IORING_OP_WRITE:
+                res = sys_write(sqe.fd, (void*)sqe.addr, sqe.len);
+                break;
+            case IORING_OP_OPEN:
+                res = bad_userspace_addr((void*)sqe.addr, 1, 0) ? -1 : sys_open((uint8_t*)sqe.addr);
+                break;
+            case IORING_OP_CLOSE:
+                res = sys_close(sqe.fd);
+                break;
+            default:
+                res = -1;
+                break;
+        }
+
+        cqe = &ring->cqes[curr_pcb->ioring_cq_tail++ & (IORING_CQ_ENTRIES - 1)];
+        cqe->user_data = sqe.user_data;
+        cqe->res = res;
+        ring->cq_tail = curr_pcb->ioring_cq_tail;
+    }
+
+    return done;
+}
+
+/* int32_t iov_check (int32_t fd, const iovec_t* iov, int32_t iovcnt, iovec_t* kiov, int write)
+ * Checks the arguments of a readv or writev and copies the buffer list into the kernel, so the program can't change
+ * it once it is checked
+ * Inputs: int32_t fd, const iovec_t* iov, int32_t iovcnt - the system call's arguments
+ *         iovec_t* kiov - IOV_MAX entries to copy the list to
+ *         int write - 1 for readv, which writes to the buffers
+ * Outputs: -1 if fd isn't open, iovcnt isn't between 1 and IOV_MAX or a buffer isn't on pages the program has,
+ *          0 otherwise
+ * Side Effects: none
+ */
+static int32_t iov_check (int32_t fd, const iovec_t* iov, int32_t iovcnt, iovec_t* kiov, int write){
+    pcb_t* curr_pcb = get_pcb_ptr();
+    int32_t i;
+
+    if(fd < 0 || fd >= FDA_SIZE || curr_pcb->fda[fd].flags == NOT_IN_USE) return -1;
+    if(iovcnt <= 0 || iovcnt > IOV_MAX) return -1;
+    if(bad_userspace_addr(iov, iovcnt * sizeof(iovec_t), 0)) return -1;
+
+    memcpy(kiov, iov, iovcnt * sizeof(iovec_t));
+    for(i = 0; i < iovcnt; i++){
+        if(kiov[i].len < 0) return -1;
+        if(kiov[i].len > 0 && (kiov[i].base == NULL || bad_userspace_addr(kiov[i].base, kiov[i].len, write))) return -1;
+    }
+    return 0;
+}
+
+/* int32_t sys_readv (int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ * Reads into several buffers in turn with one system call, through the driver's readv if it has one and one read
+ * per buffer otherwise
+ * Inputs: int32_t fd - an open file
+ *         const iovec_t* iov - the buffers
+ *         int32_t iovcnt - how many, at most IOV_MAX
+ * Outputs: -1 if an argument is bad or the first read fails, the number of bytes read otherwise
+ * Side Effects: stops after a buffer that isn't filled up, like read stops at the end of a file or line
+ */
+int32_t sys_readv (int32_t fd, const iovec_t* iov, int32_t iovcnt){
+    pcb_t* curr_pcb = get_pcb_ptr();
+    iovec_t kiov[IOV_MAX];
+    int32_t i, cnt, total;
+
+    if(iov_check(fd, iov, iovcnt, kiov, 1) == -1) return -1;
+    if(curr_pcb->fda[fd].fops_ptr.readv != NULL){
+        return curr_pcb->fda[fd].fops_ptr.readv(fd, kiov, iovcnt);
+    }
+
+    for(total = 0, i = 0; i < iovcnt; i++){
+        if(kiov[i].len == 0) continue;
+        cnt = curr_pcb->fda[fd].fops_ptr.read(fd, kiov[i].base, kiov[i].len);
+        if(cnt < 0) return (total == 0) ? -1 : total;
+        total += cnt;
+        if(cnt < kiov[i].len) break;
+    }
+    return total;
+}
+
+/* int32_t sys_writev (int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ * Writes several buffers in turn with one system call, through the driver's writev if it has one and one write
+ * per buffer otherwise
+ * Inputs: int32_t fd - an open file
+ *         const iovec_t* iov - the buffers
+ *         int32_t iovcnt - how many, at most IOV_MAX
+ * Outputs: -1 if an argument is bad or the first write fails, the number of bytes written otherwise
+ * Side Effects: stops after a buffer that isn't written completely
+ */
+int32_t sys_writev (int32_t fd, const iovec_t* iov, int32_t iovcnt){
+    pcb_t* curr_pcb = get_pcb_ptr();
+    iovec_t kiov[IOV_MAX];
+    int32_t i, cnt, total;
+
+    if(iov_check(fd, iov, iovcnt, kiov, 0) == -1) return -1;
+    if(curr_pcb->fda[fd].fops_ptr.writev != NULL){
+        return curr_pcb->fda[fd].fops_ptr.writev(fd, kiov, iovcnt);
+    }
+
+    for(total = 0, i = 0; i < iovcnt; i++){
+        if(kiov[i].len == 0) continue;
+        cnt = curr_pcb->fda[fd].fops_ptr.write(fd, kiov[i].base, kiov[i].len);
+        if(cnt < 0) return (total == 0) ? -1 : total;
+        total += cnt;
+        if(cnt < kiov[i].len) break;
+    }
+    return total;
+}
+
+/* int32_t sys_lseek (int32_t fd, int32_t offset, int32_t whence)
+ * Moves the position the next read of a regular file starts at
+ * Inputs: int32_t fd - a regular file the program has open
+ *         int32_t offset - bytes to move
+ *         int32_t whence - SEEK_SET (from the start), SEEK_CUR (from the current position) or SEEK_END (from the end)
+ * Outputs: -1 if fd isn't an open regular file, whence is bad or the position would be negative,
+ *          the new position otherwise
+ * Side Effects: a position past the end is allowed, reads there return 0
+ */
+int32_t sys_lseek (int32_t fd, int32_t offset, int32_t whence){
+    pcb_t* curr_pcb = get_pcb_ptr();
+    int32_t base;
+
+    if(fd < 0 || fd >= FDA_SIZE || curr_pcb->fda[fd].flags == NOT_IN_USE || curr_pcb->fda[fd].fops_ptr.read != file_read){
+        return -1;
+    }
+
+    switch(whence){
+        case SEEK_SET:
+            base = 0;
+            break;
+        case SEEK_CUR:
+            base = curr_pcb->fda[fd].file_position;
+            break;
+        case SEEK_END:
+            base = file_length(fd);
+            break;
+        default:
+            return -1;
+    }
+    if(offset < -base || (offset > 0 && base > 0x7FFFFFFF - offset)){
+        return -1;
+    }
+
+    curr_pcb->fda[fd].file_position = base + offset;
+    return base + offset;
+}
+
+/* int32_t sys_pread (int32_t fd, const iovec_t* iov, int32_t offset)
+ * Reads from a given position of a regular file, without using or moving the fd's position - the buffer comes as
+ * an iovec since there are only three argument registers
+ * Inputs: int32_t fd - a regular file the program has open
+ *         const iovec_t* iov - one buffer and its size
+ *         int32_t offset - where in the file to read from
+ * Outputs: -1 if fd isn't an open regular file, the buffer isn't on pages the program may write or offset is negative,
+ *          the number of bytes read otherwise (0 at or past the end)
+ * Side Effects: none
+ */
+int32_t sys_pread (int32_t fd, const iovec_t* iov, int32_t offset){
+    pcb_t* curr_pcb = get_pcb_ptr();
+    iovec_t kiov;
+
+    if(iov_check(fd, iov, 1, &kiov, 1) == -1 || curr_pcb->fda[fd].fops_ptr.read != file_read || offset < 0){
+        return -1;
+    }
+    if(kiov.len == 0){
+        return 0;
+    }
+
+    return (int32_t)read_data(curr_pcb->fda[fd].inode, offset, kiov.base, kiov.len);
+}
+
+/* int32_t sys_sysstats (int32_t pid, sysstats_t* buf)
+ * Reports how often each system call was made, how often it failed and how long it took (a log2 histogram of TSC
+ * cycles)
+ * Inputs: int32_t pid - the process to report on, -1 for every call since boot
+ *         sysstats_t* buf - where to put the table
+ * Outputs: -1 if buf isn't on pages the program has or there is no such process, 0 otherwise
+ * Side Effects: a process' own table only has its calls since it started - all zero if it hasn't made any
+ */
+int32_t sys_sysstats (int32_t pid, sysstats_t* buf){
+    pcb_t* task;
+    uint32_t flags;
+
+    if(bad_userspace_addr(buf, sizeof(sysstats_t), 1)) return -1;
+
+    if(pid == -1){
+        sysstats_get_total(buf);
+        return 0;
+    }
+    if(pid < 0 || pid >= MAX_NUM_PIDS) return -1;
+
+    cli_and_save(flags);
+    if(pcb_table[pid] == NULL){
+        restore_flags(flags);
+        return -1;
+    }
+    task = get_pcb_from_pid(pid);
+    if(task->sc_stats == NULL){
+        memset(buf, 0, sizeof(sysstats_t));
+    }
+    else{
+        memcpy(buf, task->sc_stats, sizeof(sysstats_t));
+    }
+    restore_flags(flags);
+
+    return 0;
+}
+
+
 /* int32_t bad call functions (args depend on function type)
  * Is a bad call function because function pointer does not exist
  * Inputs: none
@@ -612,9 +1274,30 @@ pcb_t* init_pcb(int pid, uint8_t* args){
     // curr_pcb->old_ebp = tss.eb
 
     // set base kernel stack (depends on the pid)
-    curr_pcb->base_kernel_stack = 0x800000 - (pid) * 0x2000;      // 8MB - (pid)*8kB
-    curr_pcb->curr_pid = pid;
+    curr_pcb->base_kernel_stack = (uint32_t)curr_pcb + KSTACK_SIZE;     // top of the kernel stack the pcb is on
+    curr_pcb->pid = pid;
     curr_pcb->args = args;
+
+    // new task is the running one, so it is not on the run queue yet
+    curr_pcb->state = TASK_RUNNABLE;
+    curr_pcb->rq_next = NULL;
+    curr_pcb->rq_prev = NULL;
+    curr_pcb->base_level = MLFQ_TOP;
+    curr_pcb->prio_level = MLFQ_TOP;
+    curr_pcb->quantum_left = 0;         // filled in by execute once the task is running
+    ktimer_setup(&curr_pcb->sleep_timer, sleep_expired, curr_pcb);
+    wq_init(&curr_pcb->sleep_wq);
+
+    // the clock starts in the kernel, execute switches it to user time right before entering the program
+    curr_pcb->start_tsc = rdtsc();
+    curr_pcb->user_cycles = 0;
+    curr_pcb->kernel_cycles = 0;
+    curr_pcb->acct_stamp = curr_pcb->start_tsc;
+    curr_pcb->acct_mode = ACCT_KERNEL;
+    curr_pcb->nr_switches = 0;
+    curr_pcb->nr_syscalls = 0;
+    curr_pcb->switch_cycles = 0;
+    curr_pcb->sc_stats = NULL;
     
     curr_pcb->term_id = curr_term;
     // strcpy(curr_pcb->args, args);
@@ -649,7 +1332,8 @@ pcb_t* get_pcb_ptr(void){
  * Outputs  : a pcb pointer
  */
 pcb_t* get_pcb_from_pid(int pid) {
-    pcb_t* pcb_ptr;
-    pcb_ptr = (pcb_t*)(EIGHT_MB - (pid + 1) * EIGHT_KB);
-    return pcb_ptr;
+    if (pid == IDLE_PID)
+        return idle_task;
+
+    return pcb_table[pid];
 }
@@ -7,16 +7,29 @@
 #include "terminal.h"
 #include "rtc.h"
 #include "schedule.h"
+#include "wait_queue.h"
+#include "clock.h"
+#include "ktimer.h"
+#include "elf.h"
+#include "frame.h"
+#include "pid.h"
+#include "kmalloc.h"
+#include "ioring.h"
+#include "sysstats.h"
 
 /* macros */
-#define MAX_NUM_PIDS    6   // up to 8 open files per task, but one is stdin and one is stdout
-#define UNUSED          0   // for pid_array
-#define USED            1   // for pid_array
+#define MAX_NUM_PIDS    PID_LIMIT   // pids come from the bitmap in pid.c, each process needs an 8kB kernel stack and a few frames
 
 #define MAX_CMD_LENGTH 127              // looking online, linux commands don't go too high
 #define MAX_ARGS_LENGTH 127             // keyboard buffer at most 127 char, subtract 10 for command
 
 #define FDA_SIZE        8   // 2 are for stdin and stdout, other 6 are for open files
+#define IOV_MAX         16  // most buffers a readv/writev takes
+
+// lseek whence
+#define SEEK_SET        0
+#define SEEK_CUR        1
+#define SEEK_END        2
 
 // for flags in fda elements
 #define IN_USE  1
@@ -29,12 +42,27 @@
 #define EIGHT_MB    0x800000
 #define EIGHT_KB    0x2000
 
+// fast system call entry
+#define CPUID_FEAT_SEP      (1 << 11)   // CPUID 1 EDX: sysenter/sysexit
+#define MSR_SYSENTER_CS     0x174       // kernel CS, sysenter/sysexit derive the other selectors from it
+#define MSR_SYSENTER_ESP    0x175
+#define MSR_SYSENTER_EIP    0x176
+
 /* System call handler declaration */
 void system_call();
 
+// sysenter entry point (syscall_linkage.S)
+void SYSENTER_ENTRY(void);
+
+// points this processor's sysenter MSRs at SYSENTER_ENTRY and its own cpu_t, if the boot processor found sysenter
+void sysenter_init_cpu(void);
+
 // intialize system calls
 void syscall_init();
 
+// filled in by getstats, defined below
+struct proc_stats;
+
 /* Actual system call handlers (CP3) */
 int32_t sys_halt (uint8_t status);
 int32_t sys_execute (const uint8_t* command);
@@ -44,6 +72,21 @@ int32_t sys_open (const uint8_t* filename);
 int32_t sys_close (int32_t fd);
 int32_t sys_getargs (uint8_t* buf, int32_t nbytes);
 int32_t sys_vidmap (uint8_t** screen_start);
+int32_t sys_set_handler (int32_t signum, void* handler_address);
+int32_t sys_sigreturn (void);
+int32_t sys_set_priority (int32_t pid, int32_t level);
+int32_t sys_getstats (struct proc_stats* buf, int32_t nentries);
+int32_t sys_clock_gettime (int32_t clock_id, timespec_t* ts);
+int32_t sys_sleep (int32_t ms);
+int32_t sys_kmemstats (kmem_stats_t* buf);
+int32_t sys_mmap (int32_t fd, int32_t length);
+int32_t sys_ioring_setup (void);
+int32_t sys_ioring_enter (int32_t to_submit);
+int32_t sys_sysstats (int32_t pid, sysstats_t* buf);
+int32_t sys_readv (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+int32_t sys_writev (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+int32_t sys_lseek (int32_t fd, int32_t offset, int32_t whence);
+int32_t sys_pread (int32_t fd, const iovec_t* iov, int32_t offset);
 
 // functions for invalid/nonexistent file operations
 int32_t bad_open(const uint8_t* filename);
@@ -59,14 +102,34 @@ typedef struct fops{
     int32_t (*write)(int32_t fd, const void* buf, int32_t nbytes);    // write
     int32_t (*close)(int32_t fd);                               // close
 
+    // optional: NULL makes readv/writev loop over read/write
+    int32_t (*readv)(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+    int32_t (*writev)(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
 } fops_t;
 
+// one entry per process for the getstats syscall - user programs have a copy of this in ece391syscall.h
+typedef struct proc_stats {
+    int32_t pid;                // -1 for the idle task
+    int32_t term_id;
+    int32_t state;              // TASK_RUNNABLE, TASK_WAITING
+    int32_t level;              // current MLFQ level
+    uint64_t start_tsc;         // TSC when the process was created
+    uint64_t user_cycles;
+    uint64_t kernel_cycles;
+    uint32_t nr_switches;
+    uint32_t nr_syscalls;
+    uint32_t switch_cycles;     // total cost of the switches to this process
+    uint64_t now_tsc;           // TSC when the entry was filled in, to turn the counters into percentages
+} proc_stats_t;
+
 typedef struct files {
     fops_t fops_ptr;            // fops table ptr
     uint32_t inode;             // inode corresponding to the file
     uint32_t file_position;     // keeps track of where the user is currently reading from in the file. 
                                 // Every read system all should update this member
     uint32_t flags;             // marking this file descriptor as "in-use" (check Appendix A): 1 is in use, 0 is not in use
+    uint32_t rtc_freq;          // RTC only: virtual frequency of this fd (the hardware runs at RTC_MAX_FREQ)
 } files_t;
 
 
@@ -96,8 +159,17 @@ typedef struct pcb {
     // pcb_t* child_pcb;                   // if this file needs to call another file
 
     uint32_t* entry_position;
-
-    int curr_pid;
+    pte_t* user_page_table;             // maps the program's 128MB - 132MB, one 4kB frame per page in use
+    uint32_t exe_inode;                 // the program's file, which pages are read in from when they are first touched
+    elf_phdr_t* exe_segs;               // its loadable segments (kmalloc'd)
+    int exe_nsegs;
+    pte_t* mmap_page_table;             // maps 136MB - 140MB onto the blocks of files the program mapped, NULL until its first mmap
+    uint32_t mmap_next;                 // where the next mmap goes
+    io_ring_t* ioring;                  // its io ring page (in the mmap region), NULL until ioring_setup
+    uint32_t ioring_sq_head;            // the kernel's own ring indexes - the copies in the page are only for the program
+    uint32_t ioring_cq_tail;
+
+    int pid;
     int parent_pid;
     int child_pid;
     
@@ -107,8 +179,34 @@ typedef struct pcb {
     int old_ebp;                        // ebp of the parent process
     int old_esp0;                       // SAVE OLD ESP0
 
-    int schedule_esp;                   // save
-    int schedule_ebp;
+    context_t ctx;                      // registers saved by switch_to while the task is switched out
+
+    int state;                          // TASK_RUNNABLE, TASK_WAITING or TASK_DEAD (schedule.h)
+    int cpu;                            // index in cpus[] of the processor whose run queue it is on, or that it runs on
+    int last_cpu;                       // the processor it last ran on - any other may have stale TLB entries for it
+    struct pcb* rq_next;                // links in the run queue
+    struct pcb* rq_prev;
+    struct pcb* wq_next;                // link in the wait queue the task is sleeping on
+
+    int prio_level;                     // MLFQ level the task is queued at (0 = highest)
+    int base_level;                     // level it goes back to on a boost, set with set_priority
+    int quantum_left;                   // ticks left at prio_level before it is demoted
+
+    ktimer_t sleep_timer;               // wakes the task up from sleep
+    wait_queue_t sleep_wq;              // the task alone sleeps on it
+
+    // CPU accounting, all in TSC cycles
+    uint64_t start_tsc;                 // when the process was created
+    uint64_t user_cycles;               // time spent running in user mode
+    uint64_t kernel_cycles;             // time spent running in the kernel (syscalls)
+    uint64_t acct_stamp;                // last time the counters above were brought up to date
+    int acct_mode;                      // ACCT_USER or ACCT_KERNEL - which counter the time since acct_stamp goes to
+    uint32_t nr_switches;               // times the scheduler switched to this process
+    uint32_t nr_syscalls;               // system calls made
+    uint32_t switch_cycles;             // time spent in switch_to switching to this process
+    sysstats_t* sc_stats;               // its system calls by number (kmalloc'd by execute), NULL for the idle tasks
+    uint32_t sc_idx;                    // sysstats entry of the system call it is in
+    uint64_t sc_start;                  // when that call started
 
     uint8_t* args;                      // for getargs syscall 
 
@@ -130,7 +228,12 @@ volatile int exception_flag;
 // flag to indicate if process is currently running (EXCEPT first shell)
 volatile int running_flag;
 
-int pid_array[MAX_NUM_PIDS];
-int curr_pid;        // needed when setting parent pid
+pcb_t* pcb_table[MAX_NUM_PIDS];     // pcb of each pid in use, NULL for free pids
+
+// pid of the task running on this processor, IDLE_PID in its idle task
+#define curr_pid    (this_cpu()->pid)
+
+// cpu_t holds this processor's curr_pid, and embeds a run queue and a TSS - so it comes after everything above
+#include "smp.h"
 
 #endif
@@ -0,0 +1,81 @@
+/* sysstats.c - Per system call counters and latency histograms, for the whole system and for each process
+ *
+ * The system call linkage hands the hooks in schedule.c the call number and the return value; they time the call
+ * with the TSC and record it here. The system wide table lives for the whole uptime, a process' own table is
+ * allocated on its first system call and goes away when it halts.
+ */
+
+#include "sysstats.h"
+#include "lib.h"
+
+static sysstats_t total;
+
+/* latency_bucket(uint64_t cycles)
+ * Inputs: cycles - latency of a call
+ * Outputs: its histogram bucket
+ */
+static uint32_t latency_bucket(uint64_t cycles){
+    uint32_t bit;
+
+    if(cycles >> 32){
+        return SYSSTATS_BUCKETS - 1;
+    }
+    if((uint32_t)cycles < (1 << SYSSTATS_MIN_SHIFT)){
+        return 0;
+    }
+    asm ("bsrl %1, %0" : "=r"(bit) : "rm"((uint32_t)cycles) : "cc");
+    bit -= SYSSTATS_MIN_SHIFT - 1;
+    return (bit < SYSSTATS_BUCKETS) ? bit : SYSSTATS_BUCKETS - 1;
+}
+
+/* sysstats_enter(sysstats_t* proc, uint32_t idx)
+ * Inputs: proc - the calling process' table, NULL if it has none
+ *         idx - SYSSTATS_IDX of the call number
+ * Outputs: none
+ * Side Effects: call with interrupts off
+ */
+void sysstats_enter(sysstats_t* proc, uint32_t idx){
+    total.nr[idx].calls++;
+    if(proc != NULL){
+        proc->nr[idx].calls++;
+    }
+}
+
+/* sysstats_exit(sysstats_t* proc, uint32_t idx, int32_t ret, uint64_t cycles)
+ * Inputs: proc - the calling process' table, NULL if it has none
+ *         idx - SYSSTATS_IDX of the call number
+ *         ret - what the call returned
+ *         cycles - how long it took
+ * Outputs: none
+ * Side Effects: call with interrupts off
+ */
+void sysstats_exit(sysstats_t* proc, uint32_t idx, int32_t ret, uint64_t cycles){
+    uint32_t bucket = latency_bucket(cycles);
+
+    total.nr[idx].cycles += cycles;
+    total.nr[idx].hist[bucket]++;
+    if(ret < 0){
+        total.nr[idx].errors++;
+    }
+
+    if(proc != NULL){
+        proc->nr[idx].cycles += cycles;
+        proc->nr[idx].hist[bucket]++;
+        if(ret < 0){
+            proc->nr[idx].errors++;
+        }
+    }
+}
+
+/* sysstats_get_total(sysstats_t* buf)
+ * Inputs: buf - where to copy the system wide table
+ * Outputs: none
+ * Side Effects: none
+ */
+void sysstats_get_total(sysstats_t* buf){
+    uint32_t flags;
+
+    cli_and_save(flags);
+    memcpy(buf, &total, sizeof(sysstats_t));
+    restore_flags(flags);
+}
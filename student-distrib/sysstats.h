@@ -0,0 +1,39 @@
+/* sysstats.h - Per system call counters and latency histograms, for the whole system and for each process
+ */
+
+#ifndef _SYSSTATS_H
+#define _SYSSTATS_H
+
+#include "types.h"
+
+#define SYSSTATS_CALLS      32          // one entry per system call number, with room for new ones - 0 and numbers
+                                        // past the end count as invalid ones in entry 0
+#define SYSSTATS_BUCKETS    24          // log2 latency histogram
+#define SYSSTATS_MIN_SHIFT  8           // bucket 0 is under 2^8 cycles, bucket b from 2^(b+7) up to 2^(b+8), the last
+                                        // one has everything from 2^30 on
+
+// one system call number - user programs have a copy of this in ece391syscall.h
+typedef struct sysstats_entry {
+    uint32_t calls;                     // counted on the way in, so halt (which never returns) has calls but no latency
+    uint32_t errors;                    // calls that returned a negative value
+    uint64_t cycles;                    // total latency in TSC cycles
+    uint32_t hist[SYSSTATS_BUCKETS];    // calls by latency
+} sysstats_entry_t;
+
+typedef struct sysstats {
+    sysstats_entry_t nr[SYSSTATS_CALLS];
+} sysstats_t;
+
+// entry for a system call number
+#define SYSSTATS_IDX(nr)    (((uint32_t)(nr) < SYSSTATS_CALLS) ? (uint32_t)(nr) : 0)
+
+// counts a call on the way in, in the system wide table and in the process' own (NULL if it has none)
+void sysstats_enter(sysstats_t* proc, uint32_t idx);
+
+// records how the call went on the way out
+void sysstats_exit(sysstats_t* proc, uint32_t idx, int32_t ret, uint64_t cycles);
+
+// copies the system wide table
+void sysstats_get_total(sysstats_t* buf);
+
+#endif /* _SYSSTATS_H */
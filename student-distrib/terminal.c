@@ -29,16 +29,19 @@ int32_t terminal_close(int32_t fd){
  * Function: Reads from keyboard buffer to buf until a newline '\n' */
 int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes){
     int bytes;
+    uint32_t flags;
 
     if(nbytes <= 0 || buf == NULL){
         return -1;
     }
 
-    // wait until '\n' is pressed
-    // cli();
-    // while(!key_flag);        // old
-    while(!terminals[scheduled_process].key_flag);      // new for terminals
-    // sti();
+    // wait until '\n' is pressed - sleep instead of spinning so other tasks get the CPU
+    // interrupts stay off between the check and the sleep so keyboard_return can't slip in between
+    cli_and_save(flags);
+    while(!terminals[scheduled_process].key_flag){
+        wq_sleep(&terminals[scheduled_process].read_wq);
+    }
+    restore_flags(flags);
 
     // bytes should be the minimum between keyboard buffer length and nbytes to read
     // bytes = (strlen(keyboard_buf) < nbytes) ? strlen(keyboard_buf) : nbytes;
@@ -57,6 +60,23 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes){
 }
 
 
+/* terminal_put_buf(const void* buf, int32_t nbytes)
+ * Inputs: buf - data to write
+ *          nbytes - number of bytes
+ * Return Value: none
+ * Function: Writes n bytes from buf to the screen of the scheduled terminal without moving the cursor,
+ *           call with interrupts off */
+static void terminal_put_buf(const void* buf, int32_t nbytes){
+    int i;      // for looping
+
+    for(i = 0; i < nbytes; i++){
+        char letter = ((char*)buf)[i];      // converting void pointer to char pointer -> need to index by array (ea char = 1 byte)
+        if(letter != '\0'){                 // do not print null bytes to screen
+            putc_nocursor(letter, scheduled_process);
+        }
+    }
+}
+
 /* terminal_write(int32_t fd, const void* buf, int32_t nbytes)
  * Inputs: fd - not relevant to terminal
  *          buf - data to write
@@ -64,32 +84,42 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes){
  * Return Value: int32_t (number of bytes written on success, -1 on failure?)
  * Function: Writes n bytes from buf to screen */
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes){
-    cli();
-
-    int i;      // for looping
-    int bytes;
+    uint32_t flags;
 
     if(nbytes <= 0 || buf == NULL){
         return -1;
     }
 
-    // int terminal = scheduled_process;
+    cli_and_save(flags);
+    terminal_put_buf(buf, nbytes);
+    // once for the whole buffer instead of after every character
+    update_cursor(terminals[curr_term].term_x, terminals[curr_term].term_y);
+    restore_flags(flags);
 
-    // bytes should be the minimum between keyboard buffer length and nbytes to read
-    bytes = (strlen((char*)buf) < nbytes) ? strlen((char*)buf) : nbytes;
+    return nbytes;
+}
 
-    for(i = 0; i < nbytes; i++){
-        char letter = ((char*)buf)[i];      // converting void pointer to char pointer -> need to index by array (ea char = 1 byte)
-        if(letter != '\0'){                 // do not print null bytes to screen
-            // putc(letter, 0);
-            // putc(letter, terminal);
-            putc(letter, scheduled_process);
+/* terminal_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ * Inputs: fd - not relevant to terminal
+ *          iov - buffers to write, in order (checked by the caller)
+ *          iovcnt - number of buffers
+ * Return Value: int32_t (number of bytes written)
+ * Function: Writes all the buffers to screen, moving the cursor once at the end */
+int32_t terminal_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt){
+    int32_t i, total = 0;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    for(i = 0; i < iovcnt; i++){
+        if(iov[i].len > 0){
+            terminal_put_buf(iov[i].base, iov[i].len);
+            total += iov[i].len;
         }
     }
+    update_cursor(terminals[curr_term].term_x, terminals[curr_term].term_y);
+    restore_flags(flags);
 
-    sti();
-
-    return nbytes;
+    return total;
 }
 
 
@@ -106,8 +136,9 @@ void switch_terminals(int next_term) {
     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].P = 1;
     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].U = 1;
     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].R = 1;
+    page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].G = 1;
     page_table[VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB].offset31_12 = (VIDMEM_ADDRESS >> ADDRESS_SHIFT_KB);
-    flush_tlb();
+    flush_tlb_page(VIDMEM_ADDRESS);
 
     // save vidmem and other things (cursor, keyboard buffer)
     // memcpy(terminals[curr_term].keyboard_buf, keyboard_buf, KEYBOARD_BUF_SIZE);     // save keyboard buffer
@@ -123,6 +154,11 @@ void switch_terminals(int next_term) {
 
     // finally switch terms
     curr_term = next_term;
+
+    // the PIT may be stopped (tickless), so fix up the running task's vidmap page now rather than on the next tick -
+    // and the other processors' tasks may be writing to either terminal through theirs
+    scheduling_vidmap(scheduled_process, curr_term);
+    smp_resched_others();
     // update_cursor(screen_x, screen_y);
     update_cursor(terminals[next_term].term_x, terminals[next_term].term_y);
     
@@ -10,6 +10,7 @@
 #include "types.h"
 #include "lib.h"
 #include "schedule.h"
+#include "wait_queue.h"
 
 // terminal driver functions below
 
@@ -25,6 +26,9 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes);
 // terminal write function
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes);
 
+// terminal write of several buffers, with a single cursor update
+int32_t terminal_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
 // boot terminals
 void boot_terminals(void);
 
@@ -50,6 +54,7 @@ typedef struct term{
     int term_pid[4];            // any given terminal can have at most 4 processes runnning (per discussion) - may not need it
     int32_t vidmem;
     int key_flag;               // key for pressing enter
+    wait_queue_t read_wq;       // tasks blocked in terminal_read until enter is pressed
 
     int ac_repeats;             // count for #times stuck at autocomplete
     int history_idx;            // idx for buffer history
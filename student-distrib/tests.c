@@ -4,6 +4,8 @@
 #include "terminal.h"
 #include "filesystem.h"
 #include "rtc.h"
+#include "frame.h"
+#include "kmalloc.h"
 
 #define PASS 1
 #define FAIL 0
@@ -443,6 +445,451 @@ void fs_test_read_large_file(){
 }
 
 
+/* Frame allocator tests */
+
+/* frame_drain - helper that takes every free frame, one at a time
+ * Inputs	: count - set to how many frames it took
+ * Outputs	: the frames, linked through their first word (0 ends the list)
+ * Side Effects	: frames_free is 0 until frame_refill
+ */
+static uint32_t frame_drain(uint32_t* count){
+	uint32_t list = 0, addr;
+
+	*count = 0;
+	while((addr = frame_alloc(0)) != 0){
+		*(uint32_t*)addr = list;
+		list = addr;
+		(*count)++;
+	}
+	return list;
+}
+
+/* frame_refill - helper that gives back everything frame_drain took
+ * Inputs	: list - from frame_drain
+ * Outputs	: None
+ * Side Effects	: None
+ */
+static void frame_refill(uint32_t list){
+	uint32_t next;
+
+	while(list != 0){
+		next = *(uint32_t*)list;
+		frame_free(list, 0);
+		list = next;
+	}
+}
+
+/* frame_split_merge_test
+ *
+ * Asserts that a block is split low half first, and that its pieces only merge back into it once the last one is freed
+ * Inputs	: None
+ * Outputs	: PASS/FAIL
+ * Side Effects	: None - all the memory it takes is given back
+ * Coverage	: frame_alloc, frame_free
+ * Files	: frame.c/h
+ */
+int frame_split_merge_test(){
+	TEST_HEADER;
+
+	uint32_t flags, block, rest, count, free_before;
+	uint32_t a, b, c, d;
+	int result = PASS;
+
+	cli_and_save(flags);
+	free_before = frames_free;
+	block = frame_alloc(FRAME_MAX_ORDER);
+	if(block == 0){
+		restore_flags(flags);
+		return FAIL;
+	}
+	// with everything else taken the one max order block is all there is to split
+	rest = frame_drain(&count);
+	frame_free(block, FRAME_MAX_ORDER);
+
+	a = frame_alloc(0);
+	b = frame_alloc(0);
+	c = frame_alloc(1);
+	d = frame_alloc(FRAME_MAX_ORDER - 1);
+	if(a != block || b != block + FRAME_SIZE || c != block + 2 * FRAME_SIZE ||
+			d != block + (FRAME_SIZE << (FRAME_MAX_ORDER - 1))){
+		result = FAIL;
+	}
+	// what is left is one free block of each order from 2 to FRAME_MAX_ORDER - 2
+	if(frames_free != (1 << (FRAME_MAX_ORDER - 1)) - 4 || frame_alloc(FRAME_MAX_ORDER - 1) != 0){
+		result = FAIL;
+	}
+
+	frame_free(d, FRAME_MAX_ORDER - 1);
+	frame_free(b, 0);
+	frame_free(a, 0);
+	if(frame_alloc(FRAME_MAX_ORDER) != 0){
+		result = FAIL;
+	}
+	// c is the last piece: order 1 up to FRAME_MAX_ORDER in one go
+	frame_free(c, 1);
+	if(frames_free != (1 << FRAME_MAX_ORDER) || frame_alloc(FRAME_MAX_ORDER) != block){
+		result = FAIL;
+	}
+
+	frame_free(block, FRAME_MAX_ORDER);
+	frame_refill(rest);
+	if(frames_free != free_before){
+		result = FAIL;
+	}
+	restore_flags(flags);
+	return result;
+}
+
+/* frame_exhaust_test
+ *
+ * Asserts that frame_alloc hands out exactly frames_free frames and then fails, and that giving them all
+ * back one at a time merges them into max order blocks again
+ * Inputs	: None
+ * Outputs	: PASS/FAIL
+ * Side Effects	: None - all the memory it takes is given back
+ * Coverage	: frame_alloc, frame_free
+ * Files	: frame.c/h
+ */
+int frame_exhaust_test(){
+	TEST_HEADER;
+
+	uint32_t flags, list, count, free_before, block;
+	int result = PASS;
+
+	cli_and_save(flags);
+	free_before = frames_free;
+	list = frame_drain(&count);
+	if(count != free_before || frames_free != 0 || frame_alloc(0) != 0 || frame_alloc(FRAME_MAX_ORDER) != 0){
+		result = FAIL;
+	}
+
+	frame_refill(list);
+	if(frames_free != free_before){
+		result = FAIL;
+	}
+	block = frame_alloc(FRAME_MAX_ORDER);
+	if(block == 0){
+		result = FAIL;
+	}
+	frame_free(block, FRAME_MAX_ORDER);
+	restore_flags(flags);
+	return result;
+}
+
+/* frame_module_test
+ *
+ * Asserts that no frame the allocator hands out overlaps the filesystem image GRUB loaded as a module,
+ * or lies outside [FRAME_BASE, FRAME_LIMIT)
+ * Inputs	: None
+ * Outputs	: PASS/FAIL
+ * Side Effects	: None - all the memory it takes is given back
+ * Coverage	: frame_init (the module ranges it skips)
+ * Files	: frame.c/h
+ */
+int frame_module_test(){
+	TEST_HEADER;
+
+	boot_block_t* boot = (boot_block_t*)filesystem_start;
+	uint32_t flags, list, addr, count, fs_end;
+	int result = PASS;
+
+	// the image is the boot block, then the inodes, then the data blocks
+	fs_end = filesystem_start + (1 + boot->inode_count + boot->data_block_count) * BLOCK_SIZE;
+
+	cli_and_save(flags);
+	list = frame_drain(&count);
+	for(addr = list; addr != 0; addr = *(uint32_t*)addr){
+		if(addr < FRAME_BASE || addr >= FRAME_LIMIT || (addr & (FRAME_SIZE - 1)) != 0 ||
+				(addr + FRAME_SIZE > filesystem_start && addr < fs_end)){
+			result = FAIL;
+		}
+	}
+	frame_refill(list);
+	restore_flags(flags);
+	return result;
+}
+
+
+/* Kernel heap tests */
+
+// what the heap tests compare against: the heap statistics and the free frames the heap draws on
+typedef struct heap_snapshot {
+	kmem_stats_t stats;
+	uint32_t frames_free;
+} heap_snapshot_t;
+
+/* heap_snapshot - helper that records the heap statistics and how many frames are free
+ * Inputs	: snap - filled in
+ * Outputs	: None
+ * Side Effects	: None
+ */
+static void heap_snapshot(heap_snapshot_t* snap){
+	kmem_get_stats(&snap->stats);
+	snap->frames_free = frames_free;
+}
+
+/* heap_given_back - helper that checks everything a test took since a snapshot is back
+ * Inputs	: before - snapshot from the start of the test
+ *		  kept - empty slabs the heap may have held on to since then (they stay out of frames_free)
+ * Outputs	: PASS if the bytes and objects in use, the large blocks and the free frames are what they were, else FAIL
+ * Side Effects	: None
+ */
+static int heap_given_back(heap_snapshot_t* before, int32_t kept){
+	heap_snapshot_t now;
+	int i;
+
+	heap_snapshot(&now);
+	for(i = 0; i < KMEM_CLASSES; i++){
+		if(now.stats.classes[i].in_use != before->stats.classes[i].in_use){
+			return FAIL;
+		}
+	}
+	if(now.stats.bytes_in_use != before->stats.bytes_in_use || now.stats.large_blocks != before->stats.large_blocks ||
+			now.stats.bytes_held != before->stats.bytes_held + kept * FRAME_SIZE || now.frames_free != before->frames_free - kept){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* kmalloc_class_test
+ *
+ * Asserts that the smallest and largest request of every size class get distinct, class aligned objects of
+ * that class, and that kfree gives them back
+ * Inputs	: None
+ * Outputs	: PASS/FAIL
+ * Side Effects	: None
+ * Coverage	: kmalloc, kfree, kmem_get_stats
+ * Files	: kmalloc.c/h
+ */
+int kmalloc_class_test(){
+	TEST_HEADER;
+
+	heap_snapshot_t before, after;
+	uint32_t flags, size, j;
+	uint8_t *a, *b;
+	int i, result = PASS;
+
+	cli_and_save(flags);
+	for(i = 0; i < KMEM_CLASSES; i++){
+		size = 1 << (KMEM_MIN_SHIFT + i);
+		heap_snapshot(&before);
+		a = kmalloc(i == 0 ? 1 : (size >> 1) + 1);
+		b = kmalloc(size);
+		heap_snapshot(&after);
+		if(a == NULL || b == NULL || a == b || ((uint32_t)a & (size - 1)) != 0 || ((uint32_t)b & (size - 1)) != 0){
+			result = FAIL;
+			kfree(a);
+			kfree(b);
+			continue;
+		}
+		if(after.stats.classes[i].in_use != before.stats.classes[i].in_use + 2 ||
+				after.stats.bytes_in_use != before.stats.bytes_in_use + 2 * size || after.stats.nr_allocs != before.stats.nr_allocs + 2){
+			result = FAIL;
+		}
+
+		// each object has room for the whole class size, without running into the other
+		memset(a, 0xAA, size);
+		memset(b, 0x55, size);
+		for(j = 0; j < size; j++){
+			if(a[j] != 0xAA){
+				result = FAIL;
+			}
+		}
+
+		kfree(a);
+		kfree(b);
+		heap_snapshot(&after);
+		// the pair may have taken a new slab, which the class can keep as its empty one
+		if(heap_given_back(&before, after.stats.classes[i].slabs - before.stats.classes[i].slabs) == FAIL ||
+				after.stats.nr_frees != before.stats.nr_frees + 2){
+			result = FAIL;
+		}
+	}
+	restore_flags(flags);
+	return result;
+}
+
+/* kmalloc_large_test
+ *
+ * Asserts that requests above KMEM_MAX_SIZE get frame aligned buddy blocks rounded up to a power of two frames,
+ * that requests too big for any block fail, and that kfree gives the frames back
+ * Inputs	: None
+ * Outputs	: PASS/FAIL
+ * Side Effects	: None
+ * Coverage	: kmalloc, kfree, kmem_get_stats
+ * Files	: kmalloc.c/h
+ */
+int kmalloc_large_test(){
+	TEST_HEADER;
+
+	heap_snapshot_t before, after;
+	uint32_t flags;
+	void *a, *b;
+	int result = PASS;
+
+	cli_and_save(flags);
+	heap_snapshot(&before);
+
+	a = kmalloc(KMEM_MAX_SIZE + 1);         // one frame
+	b = kmalloc(3 * FRAME_SIZE);            // four
+	heap_snapshot(&after);
+	if(a == NULL || b == NULL || ((uint32_t)a & (FRAME_SIZE - 1)) != 0 || ((uint32_t)b & (4 * FRAME_SIZE - 1)) != 0){
+		result = FAIL;
+	}
+	if(after.stats.large_blocks != before.stats.large_blocks + 2 || after.stats.bytes_in_use != before.stats.bytes_in_use + 5 * FRAME_SIZE ||
+			after.stats.bytes_held != before.stats.bytes_held + 5 * FRAME_SIZE || after.frames_free != before.frames_free - 5){
+		result = FAIL;
+	}
+	if(kmalloc(FRAME_SIZE << (FRAME_MAX_ORDER + 1)) != NULL || kmalloc(0) != NULL){
+		result = FAIL;
+	}
+
+	kfree(a);
+	kfree(b);
+	if(heap_given_back(&before, 0) == FAIL){
+		result = FAIL;
+	}
+	restore_flags(flags);
+	return result;
+}
+
+/* kmalloc_reuse_test
+ *
+ * Asserts that a freed object is the next one handed out, that a class only takes a new slab once every
+ * object it has is in use, and that freeing everything again gives back all but the one empty slab a class
+ * may keep
+ * Inputs	: None
+ * Outputs	: PASS/FAIL
+ * Side Effects	: None
+ * Coverage	: kmalloc, kfree, kmem_get_stats
+ * Files	: kmalloc.c/h
+ */
+int kmalloc_reuse_test(){
+	TEST_HEADER;
+
+	heap_snapshot_t before, after;
+	uint32_t flags, size, n, i;
+	void *p, *obj, *list = NULL;
+	int cls = 3, result = PASS;
+	int32_t kept;
+
+	size = 1 << (KMEM_MIN_SHIFT + cls);
+	cli_and_save(flags);
+
+	p = kmalloc(size);
+	kfree(p);
+	if(p == NULL || kmalloc(size) != p){
+		result = FAIL;
+	}
+	kfree(p);
+	p = kmalloc(2 * FRAME_SIZE);
+	kfree(p);
+	if(p == NULL || kmalloc(2 * FRAME_SIZE) != p){
+		result = FAIL;
+	}
+	kfree(p);
+
+	heap_snapshot(&before);
+
+	// every free object in the class, then one that needs a new slab
+	n = before.stats.classes[cls].objects - before.stats.classes[cls].in_use + 1;
+	for(i = 0; i < n; i++){
+		obj = kmalloc(size);
+		if(obj == NULL){
+			result = FAIL;
+			break;
+		}
+		*(void**)obj = list;
+		list = obj;
+	}
+	heap_snapshot(&after);
+	if(after.stats.classes[cls].slabs != before.stats.classes[cls].slabs + 1 ||
+			after.stats.classes[cls].in_use != before.stats.classes[cls].in_use + n || after.frames_free != before.frames_free - 1){
+		result = FAIL;
+	}
+
+	while(list != NULL){
+		obj = list;
+		list = *(void**)obj;
+		kfree(obj);
+	}
+	heap_snapshot(&after);
+	// every slab the class still has that it didn't have before is one of its empty ones
+	kept = after.stats.classes[cls].slabs - before.stats.classes[cls].slabs;
+	if(kept < 0 || kept > KMEM_EMPTY_MAX || heap_given_back(&before, kept) == FAIL){
+		result = FAIL;
+	}
+	restore_flags(flags);
+	return result;
+}
+
+/* kmem_stats_consistent - helper that checks the heap statistics add up: every byte held is either a slab or
+ * a large block, every byte in use is either a class object or a large block, and no class has more in use than
+ * it has room for
+ * Inputs	: None
+ * Outputs	: PASS/FAIL
+ * Side Effects	: None
+ */
+static int kmem_stats_consistent(void){
+	kmem_stats_t stats;
+	uint32_t slab_bytes = 0, object_bytes = 0, objects_in_use = 0;
+	int i;
+
+	kmem_get_stats(&stats);
+	for(i = 0; i < KMEM_CLASSES; i++){
+		if(stats.classes[i].size != (1 << (KMEM_MIN_SHIFT + i)) || stats.classes[i].in_use > stats.classes[i].objects){
+			return FAIL;
+		}
+		slab_bytes += stats.classes[i].slabs * FRAME_SIZE;
+		object_bytes += stats.classes[i].in_use * stats.classes[i].size;
+		objects_in_use += stats.classes[i].in_use;
+	}
+	if(stats.bytes_in_use < object_bytes || stats.bytes_held != slab_bytes + (stats.bytes_in_use - object_bytes) ||
+			stats.bytes_held < stats.bytes_in_use || stats.nr_allocs - stats.nr_frees < objects_in_use + stats.large_blocks){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* kmem_stats_test
+ *
+ * Asserts that the heap statistics add up (kmem_stats_consistent) before, while and after an object of every
+ * size class and a large block are live
+ * Inputs	: None
+ * Outputs	: PASS/FAIL
+ * Side Effects	: None
+ * Coverage	: kmem_get_stats
+ * Files	: kmalloc.c/h
+ */
+int kmem_stats_test(){
+	TEST_HEADER;
+
+	void* ptrs[KMEM_CLASSES + 1];
+	uint32_t flags;
+	int i, result = PASS;
+
+	cli_and_save(flags);
+	if(kmem_stats_consistent() == FAIL){
+		result = FAIL;
+	}
+	for(i = 0; i < KMEM_CLASSES; i++){
+		ptrs[i] = kmalloc(1 << (KMEM_MIN_SHIFT + i));
+	}
+	ptrs[KMEM_CLASSES] = kmalloc(5 * FRAME_SIZE);
+	if(kmem_stats_consistent() == FAIL){
+		result = FAIL;
+	}
+	for(i = 0; i <= KMEM_CLASSES; i++){
+		kfree(ptrs[i]);
+	}
+	if(kmem_stats_consistent() == FAIL){
+		result = FAIL;
+	}
+	restore_flags(flags);
+	return result;
+}
+
+
 /* Checkpoint 3 tests */
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
@@ -471,4 +918,11 @@ void launch_tests(){
 	// fs_test_read_small_file();
 	// fs_test_read_executable();
 	// fs_test_read_large_file();
+	TEST_OUTPUT("frame_split_merge_test", frame_split_merge_test());
+	TEST_OUTPUT("frame_exhaust_test", frame_exhaust_test());
+	TEST_OUTPUT("frame_module_test", frame_module_test());
+	TEST_OUTPUT("kmalloc_class_test", kmalloc_class_test());
+	TEST_OUTPUT("kmalloc_large_test", kmalloc_large_test());
+	TEST_OUTPUT("kmalloc_reuse_test", kmalloc_reuse_test());
+	TEST_OUTPUT("kmem_stats_test", kmem_stats_test());
 }
@@ -0,0 +1,101 @@
+/* wait_queue.c - Sleep/wake primitives built on top of the scheduler's run queue
+ */
+
+#include "wait_queue.h"
+#include "syscall.h"
+
+/* void wq_init(wait_queue_t* wq)
+ * Inputs: wq - wait queue to initialize
+ * Outputs: none
+ * Side Effects: queue is empty afterwards
+ */
+void wq_init(wait_queue_t* wq){
+    wq->head = NULL;
+    wq->tail = NULL;
+}
+
+/* void wq_sleep(wait_queue_t* wq)
+ * Blocks the running task on wq and gives the CPU to the next runnable task.
+ * Callers should re-check their wake-up condition in a loop, with interrupts
+ * disabled between the check and the sleep so a wake-up cannot be missed.
+ * Inputs: wq - queue to sleep on
+ * Outputs: none
+ * Side Effects: returns with interrupts disabled once the task has been woken
+ */
+void wq_sleep(wait_queue_t* wq){
+    pcb_t* curr_pcb = get_pcb_from_pid(curr_pid);
+
+    // append to the tail so wake-ups are FIFO
+    curr_pcb->wq_next = NULL;
+    if(wq->tail != NULL){
+        wq->tail->wq_next = curr_pcb;
+    }
+    else{
+        wq->head = curr_pcb;
+    }
+    wq->tail = curr_pcb;
+
+    curr_pcb->state = TASK_WAITING;
+
+    // a waiting task is never re-queued (the idle task runs if nobody else can), so this only comes back once we have been woken
+    schedule();
+}
+
+/* void wq_wake_common(wait_queue_t* wq, int preempt)
+ * Inputs: wq - queue whose sleepers should be woken
+ *         preempt - 1 to let the woken tasks preempt the running one
+ * Outputs: none
+ * Side Effects: every sleeper is marked runnable and put on a run queue - the one of the processor it last ran on,
+ *               or an idle one's
+ */
+static void wq_wake_common(wait_queue_t* wq, int preempt){
+    pcb_t* task = wq->head;
+    pcb_t* next;
+
+    wq->head = NULL;
+    wq->tail = NULL;
+
+    while(task != NULL){
+        next = task->wq_next;
+        task->wq_next = NULL;
+
+        if(task->state == TASK_WAITING){
+            task->state = TASK_RUNNABLE;
+
+            // the running task may be halting in wq_sleep - it must not end up on the run queue twice
+            if(!task_running(task)){
+                rq_wake(task);
+                if(preempt){
+                    wakeup_preempt(task);
+                }
+            }
+        }
+        task = next;
+    }
+
+    // somebody else may have to be preempted for the woken tasks now, so the PIT needs to tick again
+    // (the idle task hands over on its own, and at most one task runs after that)
+    if(this_cpu()->tickless && this_cpu()->rq.count > 0 && curr_pid != IDLE_PID){
+        tick_restart();
+    }
+}
+
+/* void wq_wake_up(wait_queue_t* wq)
+ * Inputs: wq - queue whose sleepers should be woken
+ * Outputs: none
+ * Side Effects: every sleeper is marked runnable and put on the run queue, they get the CPU when the scheduler picks them
+ */
+void wq_wake_up(wait_queue_t* wq){
+    wq_wake_common(wq, 0);
+}
+
+/* void wq_wake_up_preempt(wait_queue_t* wq)
+ * Wakes up sleepers that someone is actively waiting on (a reader of the terminal being typed on).
+ * Inputs: wq - queue whose sleepers should be woken
+ * Outputs: none
+ * Side Effects: sleepers get a fresh quantum at their base level, and need_resched is set if one of them
+ *               should run before the interrupted task - the interrupt handler reschedules on its way out
+ */
+void wq_wake_up_preempt(wait_queue_t* wq){
+    wq_wake_common(wq, 1);
+}
@@ -0,0 +1,30 @@
+/* wait_queue.h - Kernel wait queues: block the running task until an event wakes it
+ */
+
+#ifndef _WAIT_QUEUE_H
+#define _WAIT_QUEUE_H
+
+#include "types.h"
+
+// pcb_t is defined in syscall.h, which (indirectly) includes this file
+struct pcb;
+
+// FIFO of tasks sleeping on some event, linked through pcb->wq_next
+typedef struct wait_queue {
+    struct pcb* head;
+    struct pcb* tail;
+} wait_queue_t;
+
+// empties a wait queue
+void wq_init(wait_queue_t* wq);
+
+// puts the running task to sleep on wq until wq_wake_up is called - call with interrupts disabled
+void wq_sleep(wait_queue_t* wq);
+
+// makes every task sleeping on wq runnable again - call with interrupts disabled
+void wq_wake_up(wait_queue_t* wq);
+
+// same, but the woken tasks preempt the running one at the end of the interrupt if they are at least as important
+void wq_wake_up_preempt(wait_queue_t* wq);
+
+#endif /* _WAIT_QUEUE_H */
@@ -0,0 +1,66 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/* write a number right-aligned in a column of the given width */
+static void put_col (uint32_t value, int32_t width)
+{
+    uint8_t buf[16];
+    int32_t len;
+
+    ece391_itoa (value, buf, 10);
+    for (len = ece391_strlen (buf); len < width; len++)
+        ece391_fdputs (1, (uint8_t*)" ");
+    ece391_fdputs (1, buf);
+}
+
+/* part * 100 / whole, for byte counts well below 4GB / 100 */
+static uint32_t percent (uint32_t part, uint32_t whole)
+{
+    if (0 == whole)
+        return 0;
+    return (part / 16 * 100) / (whole / 16);
+}
+
+/* usage: kmem - prints the kernel heap statistics */
+int main ()
+{
+    struct ece391_kmem_stats stats;
+    struct ece391_kmem_class_stats* c;
+    int32_t i;
+
+    if (-1 == ece391_kmemstats (&stats)) {
+        ece391_fdputs (1, (uint8_t*)"kmemstats failed\n");
+	return 3;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"in use ");
+    put_col (stats.bytes_in_use, 0);
+    ece391_fdputs (1, (uint8_t*)" B, held ");
+    put_col (stats.bytes_held, 0);
+    ece391_fdputs (1, (uint8_t*)" B, fragmentation ");
+    put_col (percent (stats.bytes_held - stats.bytes_in_use, stats.bytes_held), 0);
+    ece391_fdputs (1, (uint8_t*)"%\nlarge blocks ");
+    put_col (stats.large_blocks, 0);
+    ece391_fdputs (1, (uint8_t*)", allocs ");
+    put_col (stats.nr_allocs, 0);
+    ece391_fdputs (1, (uint8_t*)", frees ");
+    put_col (stats.nr_frees, 0);
+    ece391_fdputs (1, (uint8_t*)"\nTLB flushes ");
+    put_col (stats.tlb_full_flushes, 0);
+    ece391_fdputs (1, (uint8_t*)", page invalidations ");
+    put_col (stats.tlb_page_flushes, 0);
+    ece391_fdputs (1, (uint8_t*)"\n\n  SIZE  SLABS  OBJECTS  IN USE  %USED\n");
+
+    for (i = 0; i < ECE391_KMEM_CLASSES; i++) {
+        c = &stats.classes[i];
+	put_col (c->size, 6);
+	put_col (c->slabs, 7);
+	put_col (c->objects, 9);
+	put_col (c->in_use, 8);
+	put_col ((0 == c->objects) ? 0 : c->in_use * 100 / c->objects, 7);
+	ece391_fdputs (1, (uint8_t*)"\n");
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+
+/* usage: nice <level> <command> [args] - runs the command at a lower priority */
+int main ()
+{
+    int32_t level, ret;
+    uint8_t buf[BUFSIZE];
+    uint8_t* cmd;
+
+    if (0 != ece391_getargs (buf, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"usage: nice <level> <command>\n");
+	return 3;
+    }
+
+    if (buf[0] < '0' || buf[0] > '9' || buf[1] != ' ') {
+        ece391_fdputs (1, (uint8_t*)"level must be a single digit\n");
+	return 3;
+    }
+    level = buf[0] - '0';
+
+    for (cmd = &buf[1]; ' ' == *cmd; cmd++);
+    if ('\0' == *cmd) {
+        ece391_fdputs (1, (uint8_t*)"usage: nice <level> <command>\n");
+	return 3;
+    }
+
+    if (-1 == ece391_set_priority (-1, level)) {
+        ece391_fdputs (1, (uint8_t*)"invalid priority level\n");
+	return 3;
+    }
+
+    if (-1 == (ret = ece391_execute (cmd))) {
+        ece391_fdputs (1, (uint8_t*)"no such command\n");
+	return 2;
+    }
+
+    return ret;
+}
@@ -0,0 +1,33 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+
+/* usage: sleep <seconds> */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    int32_t i, secs;
+
+    if (0 != ece391_getargs (buf, BUFSIZE) || '\0' == buf[0]) {
+        ece391_fdputs (1, (uint8_t*)"usage: sleep <seconds>\n");
+	return 3;
+    }
+
+    secs = 0;
+    for (i = 0; '\0' != buf[i]; i++) {
+        if (buf[i] < '0' || buf[i] > '9' || secs > 100000) {
+	    ece391_fdputs (1, (uint8_t*)"seconds must be a number\n");
+	    return 3;
+	}
+	secs = secs * 10 + buf[i] - '0';
+    }
+
+    if (-1 == ece391_sleep (secs * 1000)) {
+        ece391_fdputs (1, (uint8_t*)"sleep failed\n");
+	return 2;
+    }
+    return 0;
+}
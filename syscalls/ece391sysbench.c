@@ -0,0 +1,60 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391sysnum.h"
+
+#define ITERATIONS 100000
+
+/* tenths of a nanosecond per call of close(-1), which fails right after the entry and exit */
+static uint32_t time_path (int32_t (*call)(int32_t, int32_t, int32_t, int32_t))
+{
+    uint64_t start;
+    int32_t i;
+
+    start = ece391_clock_ns (ECE391_CLOCK_MONOTONIC);
+    for (i = 0; i < ITERATIONS; i++)
+        call (SYS_CLOSE, -1, 0, 0);
+    return (uint32_t)(ece391_clock_ns (ECE391_CLOCK_MONOTONIC) - start) / (ITERATIONS / 10);
+}
+
+static void put_tenths (uint8_t* label, uint32_t tenths)
+{
+    uint8_t buf[16];
+
+    ece391_fdputs (1, label);
+    ece391_itoa (tenths / 10, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)".");
+    ece391_itoa (tenths % 10, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)" ns per call\n");
+}
+
+/* usage: sysbench - compares a null system call through int $0x80 and through sysenter */
+int main ()
+{
+    uint32_t slow, fast;
+    uint8_t buf[16];
+
+    slow = time_path (ece391_syscall_int80);
+    put_tenths ((uint8_t*)"int $0x80: ", slow);
+
+    if (0 == ECE391_TIME_PAGE->sysenter) {
+        ece391_fdputs (1, (uint8_t*)"sysenter: not supported by this CPU\n");
+	return 0;
+    }
+    fast = time_path (ece391_syscall_sysenter);
+    put_tenths ((uint8_t*)"sysenter:  ", fast);
+
+    if (0 != fast) {
+        ece391_fdputs (1, (uint8_t*)"speedup:   ");
+	ece391_itoa (slow / fast, buf, 10);
+	ece391_fdputs (1, buf);
+	ece391_fdputs (1, (uint8_t*)".");
+	ece391_itoa (slow * 10 / fast % 10, buf, 10);
+	ece391_fdputs (1, buf);
+	ece391_fdputs (1, (uint8_t*)"x\n");
+    }
+    return 0;
+}
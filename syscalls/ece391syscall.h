@@ -22,6 +22,223 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 
+/*
+ * Priority levels run from 0 (highest, the default) to 2 (lowest).  A pid
+ * of -1 means the calling program.  Programs executed afterwards inherit
+ * the level.
+ */
+extern int32_t ece391_set_priority (int32_t pid, int32_t level);
+
+/*
+ * CPU accounting for one process, in TSC cycles.  getstats fills in one
+ * entry per process, with the idle task (pid -1) first, and returns the
+ * number of entries, in pid order.  The array may hold at most 1025
+ * entries (idle task + 1024 pids); a smaller one gets the lowest pids.
+ */
+struct ece391_proc_stats {
+	int32_t pid;
+	int32_t term_id;
+	int32_t state;		/* 0 runnable, 1 waiting */
+	int32_t level;
+	uint64_t start_tsc;
+	uint64_t user_cycles;
+	uint64_t kernel_cycles;
+	uint32_t nr_switches;
+	uint32_t nr_syscalls;
+	uint32_t switch_cycles;	/* total cost of the switches to it */
+	uint64_t now_tsc;
+};
+
+extern int32_t ece391_getstats (struct ece391_proc_stats* buf, int32_t nentries);
+
+/*
+ * CLOCK_REALTIME is seconds since 1970 (good to about a second), and
+ * CLOCK_MONOTONIC is time since boot, from the TSC.
+ */
+#define ECE391_CLOCK_REALTIME	0
+#define ECE391_CLOCK_MONOTONIC	1
+
+struct ece391_timespec {
+	uint32_t tv_sec;
+	uint32_t tv_nsec;
+};
+
+extern int32_t ece391_clock_gettime (int32_t clock_id, struct ece391_timespec* ts);
+
+/*
+ * The same clocks are readable without a system call from a read-only
+ * page every program has at ECE391_TIME_PAGE (ece391_clock_ns in
+ * ece391support.c does it).  For a TSC value t, monotonic nanoseconds are
+ * ((t - base_tsc) * mult) >> shift, and realtime adds wall_offset_ns.
+ */
+#define ECE391_TIME_PAGE	((const volatile struct ece391_time_page*)0x08401000)
+
+struct ece391_time_page {
+	uint64_t base_tsc;
+	uint64_t wall_offset_ns;
+	uint32_t mult;
+	uint32_t shift;
+	uint32_t tsc_khz;
+	uint32_t sysenter;	/* nonzero if system calls go through sysenter */
+};
+
+/*
+ * Blocks for at least ms milliseconds without using the CPU (a few hours
+ * at most).  Unlike an RTC read loop, it leaves the RTC to other programs.
+ */
+extern int32_t ece391_sleep (int32_t ms);
+
+/*
+ * Kernel heap statistics.  Small allocations come from 7 size classes
+ * (16 to 1024 bytes) carved out of 4kB slabs, larger ones get whole
+ * page frames.  bytes_held - bytes_in_use is what the heap loses to
+ * fragmentation and slab headers.
+ */
+#define ECE391_KMEM_CLASSES 7
+
+struct ece391_kmem_class_stats {
+	uint32_t size;
+	uint32_t slabs;
+	uint32_t objects;	/* room in those slabs */
+	uint32_t in_use;
+};
+
+struct ece391_kmem_stats {
+	uint32_t bytes_in_use;
+	uint32_t bytes_held;
+	uint32_t large_blocks;
+	uint32_t nr_allocs;
+	uint32_t nr_frees;
+	uint32_t tlb_full_flushes;	/* CR3 reloads since boot */
+	uint32_t tlb_page_flushes;	/* single page invalidations */
+	struct ece391_kmem_class_stats classes[ECE391_KMEM_CLASSES];
+};
+
+extern int32_t ece391_kmemstats (struct ece391_kmem_stats* buf);
+
+/*
+ * System call number (ece391sysnum.h) with up to three arguments, forced
+ * through int $0x80 or sysenter.  The ece391_* calls above pick sysenter
+ * themselves when the time page's sysenter flag is set; these are for
+ * comparing the two paths.
+ */
+extern int32_t ece391_syscall_int80 (int32_t number, int32_t a, int32_t b, int32_t c);
+extern int32_t ece391_syscall_sysenter (int32_t number, int32_t a, int32_t b, int32_t c);
+
+/*
+ * Maps the first length bytes of an open file read-only into the program,
+ * without copying them: the pages are the filesystem's own data blocks.
+ * Returns the address, or ECE391_MAP_FAILED.  A length past the end of the
+ * file maps the whole file, padded to a page; there are 4MB of room for
+ * mappings, which last until the program halts.
+ */
+#define ECE391_MAP_FAILED	((void*)-1)
+
+extern void* ece391_mmap (int32_t fd, int32_t length);
+
+/*
+ * A page of submission and completion rings shared with the kernel, so
+ * several read/write/open/close calls cost one system call.  Fill in
+ * sqes[sq_tail % ECE391_IORING_SQ_ENTRIES] and bump sq_tail for each
+ * call, then hand them all over with ece391_ioring_enter; each one gets a
+ * completion with its user_data and what the call returned.  Reap them
+ * from cq_head up to cq_tail and bump cq_head.  The kernel runs them in
+ * order, and stops early if the completion ring is full.
+ * ece391_ioring_setup returns the page (the same one every time), or
+ * ECE391_IORING_FAILED.
+ */
+#define ECE391_IORING_FAILED	((void*)-1)
+
+#define ECE391_IORING_SQ_ENTRIES	64
+#define ECE391_IORING_CQ_ENTRIES	128
+
+#define ECE391_IORING_OP_NOP	0
+#define ECE391_IORING_OP_READ	1
+#define ECE391_IORING_OP_WRITE	2
+#define ECE391_IORING_OP_OPEN	3	/* addr is the file name */
+#define ECE391_IORING_OP_CLOSE	4
+
+struct ece391_io_sqe {
+	uint32_t user_data;
+	uint16_t op;
+	int16_t fd;
+	uint32_t addr;
+	int32_t len;
+};
+
+struct ece391_io_cqe {
+	uint32_t user_data;
+	int32_t res;
+};
+
+struct ece391_io_ring {
+	volatile uint32_t sq_head;	/* written by the kernel */
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;	/* written by the kernel */
+	uint32_t reserved[12];
+	struct ece391_io_sqe sqes[ECE391_IORING_SQ_ENTRIES];
+	struct ece391_io_cqe cqes[ECE391_IORING_CQ_ENTRIES];
+};
+
+extern struct ece391_io_ring* ece391_ioring_setup (void);
+extern int32_t ece391_ioring_enter (int32_t to_submit);
+
+/*
+ * How often each system call (by number, ece391sysnum.h) was made, how
+ * often it returned -1, and a histogram of how many TSC cycles it took:
+ * bucket 0 is under 2^8 cycles, bucket b from 2^(b+7) to 2^(b+8), and the
+ * last one everything longer.  Entry 0 counts calls with a bad number.
+ * pid -1 gives every call since boot, any other pid only that process'.
+ * halt is counted but never finishes, so it has no latency.
+ */
+#define ECE391_SYSSTATS_CALLS		32
+#define ECE391_SYSSTATS_BUCKETS		24
+#define ECE391_SYSSTATS_MIN_SHIFT	8
+
+struct ece391_sysstats_entry {
+	uint32_t calls;
+	uint32_t errors;
+	uint64_t cycles;
+	uint32_t hist[ECE391_SYSSTATS_BUCKETS];
+};
+
+struct ece391_sysstats {
+	struct ece391_sysstats_entry nr[ECE391_SYSSTATS_CALLS];
+};
+
+extern int32_t ece391_sysstats (int32_t pid, struct ece391_sysstats* buf);
+
+/*
+ * read/write with up to ECE391_IOV_MAX buffers in one call, filled or
+ * written in order.  Return the total number of bytes; a buffer that
+ * isn't filled up (end of file, end of line) ends a readv early.  On the
+ * terminal, writev moves the cursor only once.
+ */
+#define ECE391_IOV_MAX	16
+
+struct ece391_iovec {
+	void* base;
+	int32_t len;
+};
+
+extern int32_t ece391_readv (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt);
+extern int32_t ece391_writev (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt);
+
+/*
+ * Random access to regular files.  lseek sets where the next read starts
+ * (whence is one of the ECE391_SEEK_* below) and returns the new
+ * position; past the end is allowed, reads there return 0.  pread reads
+ * into the one buffer iov describes from the given offset, leaving the
+ * position alone.  Both fail on the terminal, the RTC and directories.
+ */
+#define ECE391_SEEK_SET	0
+#define ECE391_SEEK_CUR	1
+#define ECE391_SEEK_END	2
+
+extern int32_t ece391_lseek (int32_t fd, int32_t offset, int32_t whence);
+extern int32_t ece391_pread (int32_t fd, const struct ece391_iovec* iov, int32_t offset);
+
 enum signums {
 	DIV_ZERO = 0,
 	SEGFAULT,
@@ -11,5 +11,21 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_SET_PRIORITY 11
+#define SYS_GETSTATS 12
+#define SYS_CLOCK_GETTIME 13
+#define SYS_SLEEP 14
+#define SYS_KMEMSTATS 15
+#define SYS_MMAP 16
+#define SYS_IORING_SETUP 17
+#define SYS_IORING_ENTER 18
+#define SYS_SYSSTATS 19
+#define SYS_READV 20
+#define SYS_WRITEV 21
+#define SYS_LSEEK 22
+#define SYS_PREAD 23
+
+/* time page word that is nonzero when the kernel takes sysenter (the stubs fall back to int $0x80) */
+#define SYSENTER_FLAG_ADDR 0x0840101C
 
 #endif /* ECE391SYSNUM_H */
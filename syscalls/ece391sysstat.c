@@ -0,0 +1,146 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NAMED_CALLS 24
+
+static const char* names[NAMED_CALLS] = {
+    "(invalid)", "halt", "execute", "read", "write", "open", "close",
+    "getargs", "vidmap", "set_handler", "sigreturn", "set_priority",
+    "getstats", "clock_gettime", "sleep", "kmemstats", "mmap",
+    "ioring_setup", "ioring_enter", "sysstats", "readv", "writev",
+    "lseek", "pread"
+};
+
+static struct ece391_sysstats stats;
+
+/* write a string left-aligned in a column of the given width */
+static void put_str (const uint8_t* s, int32_t width)
+{
+    int32_t len;
+
+    ece391_fdputs (1, s);
+    for (len = ece391_strlen (s); len < width; len++)
+        ece391_fdputs (1, (uint8_t*)" ");
+}
+
+/* write a number right-aligned in a column of the given width */
+static void put_col (uint32_t value, int32_t width)
+{
+    uint8_t buf[16];
+    int32_t len;
+
+    ece391_itoa (value, buf, 10);
+    for (len = ece391_strlen (buf); len < width; len++)
+        ece391_fdputs (1, (uint8_t*)" ");
+    ece391_fdputs (1, buf);
+}
+
+/* write the upper bound of a histogram bucket, in cycles, right-aligned in 8 columns */
+static void put_bucket (int32_t b)
+{
+    uint8_t buf[16];
+    uint32_t shift = b + ECE391_SYSSTATS_MIN_SHIFT;
+    int32_t len;
+
+    if (ECE391_SYSSTATS_BUCKETS - 1 == b) {
+        ece391_fdputs (1, (uint8_t*)"    >=1G");
+	return;
+    }
+    buf[0] = '<';
+    if (shift >= 30)
+        ece391_itoa (1 << (shift - 30), buf + 1, 10);
+    else if (shift >= 20)
+        ece391_itoa (1 << (shift - 20), buf + 1, 10);
+    else if (shift >= 10)
+        ece391_itoa (1 << (shift - 10), buf + 1, 10);
+    else
+        ece391_itoa (1 << shift, buf + 1, 10);
+    len = ece391_strlen (buf);
+    buf[len++] = (shift >= 30) ? 'G' : (shift >= 20) ? 'M' : (shift >= 10) ? 'k' : '\0';
+    buf[len] = '\0';
+    for (len = ece391_strlen (buf); len < 8; len++)
+        ece391_fdputs (1, (uint8_t*)" ");
+    ece391_fdputs (1, buf);
+}
+
+/* bucket the given percentile of the histogram falls in */
+static int32_t percentile (const uint32_t* hist, uint32_t timed, uint32_t pct)
+{
+    uint32_t seen, need;
+    int32_t b;
+
+    /* timed * pct / 100 rounded up, without overflowing for big counts */
+    need = timed / 100 * pct + ((timed % 100) * pct + 99) / 100;
+    for (seen = 0, b = 0; b < ECE391_SYSSTATS_BUCKETS - 1; b++) {
+        seen += hist[b];
+	if (seen >= need)
+	    break;
+    }
+    return b;
+}
+
+/* cycles / calls without 64-bit division - scale both down until the cycles fit */
+static uint32_t average (uint64_t cycles, uint32_t calls)
+{
+    while ((cycles >> 32) && calls > 1) {
+        cycles >>= 1;
+	calls >>= 1;
+    }
+    if (0 == calls)
+        return 0;
+    return (uint32_t)cycles / calls;
+}
+
+/* usage: sysstat [pid] - prints system call counts and latencies (in TSC cycles), since boot or for one process */
+int main ()
+{
+    struct ece391_sysstats_entry* e;
+    uint8_t buf[16];
+    int32_t pid, i, b, max;
+    uint32_t timed;
+
+    pid = -1;
+    if (0 == ece391_getargs (buf, 16)) {
+        for (pid = 0, i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+	    pid = pid * 10 + buf[i] - '0';
+    }
+
+    if (-1 == ece391_sysstats (pid, &stats)) {
+        ece391_fdputs (1, (uint8_t*)"no such process\n");
+	return 3;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"CALL              CALLS  ERRORS  AVG CYC     P50     P99     MAX\n");
+    for (i = 0; i < ECE391_SYSSTATS_CALLS; i++) {
+        e = &stats.nr[i];
+	if (0 == e->calls)
+	    continue;
+
+	if (i < NAMED_CALLS) {
+	    put_str ((uint8_t*)names[i], 14);
+	} else {
+	    ece391_itoa (i, buf, 10);
+	    put_str (buf, 14);
+	}
+	put_col (e->calls, 9);
+	put_col (e->errors, 8);
+
+	for (timed = 0, max = -1, b = 0; b < ECE391_SYSSTATS_BUCKETS; b++) {
+	    timed += e->hist[b];
+	    if (0 != e->hist[b])
+	        max = b;
+	}
+	if (0 == timed) {
+	    ece391_fdputs (1, (uint8_t*)"        -       -       -       -\n");
+	    continue;
+	}
+	put_col (average (e->cycles, timed), 9);
+	put_bucket (percentile (e->hist, timed, 50));
+	put_bucket (percentile (e->hist, timed, 99));
+	put_bucket (max);
+	ece391_fdputs (1, (uint8_t*)"\n");
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define MAX_ENTRIES 64		/* idle task + the first 63 processes */
+#define DEFAULT_REFRESHES 10
+#define RTC_FREQ 2		/* two RTC reads per refresh -> once a second */
+
+/* previous sample per row - a row that now shows another process is caught by its start_tsc */
+static struct ece391_proc_stats prev[MAX_ENTRIES];
+static struct ece391_proc_stats stats[MAX_ENTRIES];
+
+/* write a number right-aligned in a column of the given width */
+static void put_col (uint32_t value, int32_t width)
+{
+    uint8_t buf[16];
+    int32_t len;
+
+    ece391_itoa (value, buf, 10);
+    for (len = ece391_strlen (buf); len < width; len++)
+        ece391_fdputs (1, (uint8_t*)" ");
+    ece391_fdputs (1, buf);
+}
+
+/* part * 100 / whole without 64-bit division - scale both down until they fit */
+static uint32_t percent (uint64_t part, uint64_t whole)
+{
+    while (whole >> 24) {
+        whole >>= 1;
+	part >>= 1;
+    }
+    if (0 == whole)
+        return 0;
+    return ((uint32_t)part * 100) / (uint32_t)whole;
+}
+
+int main ()
+{
+    struct ece391_proc_stats* old;
+    uint8_t buf[16];
+    int32_t i, cnt, refreshes, rtc_fd, freq, garbage;
+    uint32_t switches;
+    uint64_t wall;
+
+    refreshes = DEFAULT_REFRESHES;
+    if (0 == ece391_getargs (buf, 16)) {
+        for (refreshes = 0, i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+	    refreshes = refreshes * 10 + buf[i] - '0';
+    }
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"could not open rtc\n");
+	return 3;
+    }
+    freq = RTC_FREQ;
+    ece391_write (rtc_fd, &freq, 4);
+
+    while (refreshes-- > 0) {
+        if (-1 == (cnt = ece391_getstats (stats, MAX_ENTRIES))) {
+	    ece391_fdputs (1, (uint8_t*)"getstats failed\n");
+	    return 3;
+	}
+
+	ece391_fdputs (1, (uint8_t*)"  PID TERM LVL STATE  %USR  %SYS  SWITCHES  SYSCALLS  CYC/SWITCH\n");
+	for (i = 0; i < cnt; i++) {
+	    old = &prev[i];
+
+	    /* a different process in this row - count from its start */
+	    if (old->start_tsc != stats[i].start_tsc) {
+	        old->start_tsc = stats[i].start_tsc;
+		old->user_cycles = 0;
+		old->kernel_cycles = 0;
+		old->nr_switches = 0;
+		old->nr_syscalls = 0;
+		old->switch_cycles = 0;
+		old->now_tsc = stats[i].start_tsc;
+	    }
+	    wall = stats[i].now_tsc - old->now_tsc;
+
+	    if (-1 == stats[i].pid)
+	        ece391_fdputs (1, (uint8_t*)" idle");
+	    else
+	        put_col (stats[i].pid, 5);
+	    put_col (stats[i].term_id + 1, 5);
+	    put_col (stats[i].level, 4);
+	    ece391_fdputs (1, (0 == stats[i].state) ? (uint8_t*)"   run" : (uint8_t*)"  wait");
+	    put_col (percent (stats[i].user_cycles - old->user_cycles, wall), 6);
+	    put_col (percent (stats[i].kernel_cycles - old->kernel_cycles, wall), 6);
+	    put_col (stats[i].nr_switches - old->nr_switches, 10);
+	    put_col (stats[i].nr_syscalls - old->nr_syscalls, 10);
+	    switches = stats[i].nr_switches - old->nr_switches;
+	    put_col ((0 == switches) ? 0 : (stats[i].switch_cycles - old->switch_cycles) / switches, 12);
+	    ece391_fdputs (1, (uint8_t*)"\n");
+
+	    *old = stats[i];
+	}
+	ece391_fdputs (1, (uint8_t*)"\n");
+
+	ece391_read (rtc_fd, &garbage, 4);
+	ece391_read (rtc_fd, &garbage, 4);
+    }
+
+    ece391_close (rtc_fd);
+    return 0;
+}